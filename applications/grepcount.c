@@ -10,10 +10,10 @@ int main(int argc, char* argv[]) {
 
   MS_Run();
   RDD* files = RDDFromFiles(argv + 2, argc - 2);
-  int matches = count(filter(map(files, GetLines), StringContains, argv[1]));
+  long matches = count(filter(map(files, GetLines), StringContains, argv[1]));
 
   MS_TearDown();
-  printf("found %d matches\n", matches);
+  printf("found %ld matches\n", matches);
 
   return 0;
 }
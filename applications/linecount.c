@@ -11,10 +11,10 @@ int main(int argc, char *argv[]) {
   MS_Run();
 
   RDD *files = RDDFromFiles(argv + 1, argc - 1);
-  int totalnumlines = count(map(files, GetLines));
+  long totalnumlines = count(map(files, GetLines));
 
   MS_TearDown();
 
-  printf("total number of lines in all files: %d\n", totalnumlines);
+  printf("total number of lines in all files: %ld\n", totalnumlines);
   return 0;
 }
@@ -25,7 +25,8 @@ int main(int argc, char* argv[]) {
   if (numfiles == 2) {
     RDD* data1 = map(map(RDDFromFiles(files, 1), GetLines), SplitCols);
     RDD* data2 = map(map(RDDFromFiles(files + 1, 1), GetLines), SplitCols);
-    print(join(data1, data2, SumJoin, (void*)&sctx), RowPrinter);
+    print(hashJoin(data1, data2, SumJoin, SumJoinKeyHash, (void*)&sctx),
+          RowPrinter);
   } else {
     int group1 = numfiles / 2;
     int group2 = numfiles - group1;
@@ -38,7 +39,8 @@ int main(int argc, char* argv[]) {
     RDD* repart1 = partitionBy(data1, ColumnHashPartitioner, 4, &pctx);
     RDD* repart2 = partitionBy(data2, ColumnHashPartitioner, 4, &pctx);
 
-    print(join(repart1, repart2, SumJoin, (void*)&sctx), RowPrinter);
+    print(hashJoin(repart1, repart2, SumJoin, SumJoinKeyHash, (void*)&sctx),
+          RowPrinter);
   }
   MS_TearDown();
 }
@@ -0,0 +1,200 @@
+// Submit/dequeue throughput of the per-worker queues of the thread pool:
+// the single mutex-protected List queue the pool started with, plain
+// work-stealing deques, and the priority buckets of deques the workers
+// use now.
+//
+// usage: ./deque_bench [threads] [ops per thread]
+//
+// Each scenario runs "threads" threads that together move
+// threads * ops elements through the queue(s):
+//   local:  every thread submits a batch and then dequeues it again,
+//           the way a worker enqueues the tasks it unblocks.
+//   skewed: thread 0 submits everything and all threads dequeue, so
+//           with deques every other thread has to steal.
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+
+#include "deque.h"
+#include "list.h"
+#include "minispark.h"
+#include "pqueue.h"
+
+#define BATCH 64
+
+typedef struct {
+    List* queue;
+    pthread_mutex_t lock;
+} MutexQueue;
+
+static MutexQueue mq;
+static Deque** deques;
+static PriorityQueue** pqueues;
+static int numthreads;
+static long opsperthread;
+static atomic_long remaining;
+static pthread_barrier_t barrier;
+
+static void mq_submit(void* elem) {
+    pthread_mutex_lock(&mq.lock);
+    list_add_elem(mq.queue, elem);
+    pthread_mutex_unlock(&mq.lock);
+}
+
+static void* mq_dequeue(void) {
+    pthread_mutex_lock(&mq.lock);
+    void* elem = list_remove_front(mq.queue);
+    pthread_mutex_unlock(&mq.lock);
+    return elem;
+}
+
+static void* ws_dequeue(int self) {
+    void* elem = deque_pop_bottom(deques[self]);
+    for (int i = 1; elem == NULL && i < numthreads; ++i) {
+        elem = deque_steal_top(deques[(self + i) % numthreads]);
+    }
+    return elem;
+}
+
+static void* pq_dequeue(int self) {
+    void* elem = pqueue_pop(pqueues[self]);
+    for (int i = 1; elem == NULL && i < numthreads; ++i) {
+        elem = pqueue_steal(pqueues[(self + i) % numthreads]);
+    }
+    return elem;
+}
+
+static void* mutex_local(void* arg) {
+    (void)arg;
+    pthread_barrier_wait(&barrier);
+    for (long done = 0; done < opsperthread; done += BATCH) {
+        for (int i = 0; i < BATCH; ++i) mq_submit((void*)1);
+        for (int i = 0; i < BATCH; ++i) mq_dequeue();
+    }
+    return NULL;
+}
+
+static void* ws_local(void* arg) {
+    int self = (int)(long)arg;
+    pthread_barrier_wait(&barrier);
+    for (long done = 0; done < opsperthread; done += BATCH) {
+        for (int i = 0; i < BATCH; ++i) deque_push_bottom(deques[self], arg);
+        for (int i = 0; i < BATCH; ++i) ws_dequeue(self);
+    }
+    return NULL;
+}
+
+static void* pq_local(void* arg) {
+    int self = (int)(long)arg;
+    pthread_barrier_wait(&barrier);
+    for (long done = 0; done < opsperthread; done += BATCH) {
+        for (int i = 0; i < BATCH; ++i) pqueue_push(pqueues[self], arg, i);
+        for (int i = 0; i < BATCH; ++i) pq_dequeue(self);
+    }
+    return NULL;
+}
+
+static void* mutex_skewed(void* arg) {
+    int self = (int)(long)arg;
+    pthread_barrier_wait(&barrier);
+    if (self == 0) {
+        for (long i = 0; i < opsperthread * numthreads; ++i) {
+            mq_submit((void*)1);
+        }
+    }
+    while (atomic_load(&remaining) > 0) {
+        if (mq_dequeue()) atomic_fetch_sub(&remaining, 1);
+    }
+    return NULL;
+}
+
+static void* ws_skewed(void* arg) {
+    int self = (int)(long)arg;
+    pthread_barrier_wait(&barrier);
+    if (self == 0) {
+        for (long i = 0; i < opsperthread * numthreads; ++i) {
+            deque_push_bottom(deques[0], (void*)1);
+        }
+    }
+    while (atomic_load(&remaining) > 0) {
+        if (ws_dequeue(self)) atomic_fetch_sub(&remaining, 1);
+    }
+    return NULL;
+}
+
+static void* pq_skewed(void* arg) {
+    int self = (int)(long)arg;
+    pthread_barrier_wait(&barrier);
+    if (self == 0) {
+        for (long i = 0; i < opsperthread * numthreads; ++i) {
+            pqueue_push(pqueues[0], (void*)1, i % BATCH);
+        }
+    }
+    while (atomic_load(&remaining) > 0) {
+        if (pq_dequeue(self)) atomic_fetch_sub(&remaining, 1);
+    }
+    return NULL;
+}
+
+static double run(void* (*fn)(void*)) {
+    pthread_t threads[numthreads];
+    struct timespec start, end;
+
+    atomic_store(&remaining, opsperthread * numthreads);
+    pthread_barrier_init(&barrier, NULL, numthreads + 1);
+    for (long i = 0; i < numthreads; ++i) {
+        pthread_create(&threads[i], NULL, fn, (void*)i);
+    }
+    pthread_barrier_wait(&barrier);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < numthreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_barrier_destroy(&barrier);
+
+    // one submit plus one dequeue per element
+    double seconds = TIME_DIFF_MICROS(start, end) / 1e6;
+    return 2.0 * opsperthread * numthreads / seconds / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+    numthreads = argc > 1 ? atoi(argv[1]) : get_nprocs();
+    opsperthread = argc > 2 ? atol(argv[2]) : 1000000;
+    if (numthreads < 1 || opsperthread < BATCH) {
+        printf("usage: %s [threads] [ops per thread >= %d]\n", argv[0],
+               BATCH);
+        return 1;
+    }
+
+    mq.queue = list_init(1024);
+    pthread_mutex_init(&mq.lock, NULL);
+    deques = malloc(sizeof(Deque*) * numthreads);
+    pqueues = malloc(sizeof(PriorityQueue*) * numthreads);
+    for (int i = 0; i < numthreads; ++i) {
+        deques[i] = deque_init(1024);
+        pqueues[i] = pqueue_init(1024);
+    }
+
+    printf("%d threads, %ld ops per thread (Mops/s, higher is better)\n",
+           numthreads, opsperthread);
+    printf("%-8s %12s %12s %12s\n", "scenario", "mutex queue", "work-steal",
+           "priority");
+    printf("%-8s %12.2f %12.2f %12.2f\n", "local", run(mutex_local),
+           run(ws_local), run(pq_local));
+    printf("%-8s %12.2f %12.2f %12.2f\n", "skewed", run(mutex_skewed),
+           run(ws_skewed), run(pq_skewed));
+
+    for (int i = 0; i < numthreads; ++i) {
+        free_deque(deques[i]);
+        free_pqueue(pqueues[i]);
+    }
+    free(deques);
+    free(pqueues);
+    free_list(mq.queue);
+    return 0;
+}
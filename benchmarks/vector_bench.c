@@ -0,0 +1,134 @@
+// Partition storage: the ring-buffer List that partitions used to be
+// built in, started at the 1024 elements the workers asked for, against
+// the chunked Vector they are built in now.
+//
+// usage: ./vector_bench [elements] [partitions]
+//
+// Scenarios, in ns per element (partitions: per partition):
+//   append:     build one partition of "elements" elements.
+//   scan:       read them back in order, as the next stage does.
+//   random:     read them at random indexes, as a join morsel probes.
+//   partitions: build and free "partitions" partitions of 10 elements,
+//               as a shuffle into many small partitions does.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "list.h"
+#include "minispark.h"
+#include "vector.h"
+
+#define LIST_PARTITION_CAPACITY 1024
+#define SMALL_PARTITION 10
+
+static long numelems;
+static long numparts;
+static long* order;  // random indexes for the random scenario
+static volatile long sink;
+
+static double elapsed_ns(struct timespec start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return TIME_DIFF_MICROS(start, end) * 1000.0;
+}
+
+static void list_run(double* ns) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    List* l = list_init(LIST_PARTITION_CAPACITY);
+    for (long i = 0; i < numelems; ++i) {
+        list_add_elem(l, (void*)i);
+    }
+    ns[0] = elapsed_ns(start) / numelems;
+
+    long sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < get_size(l); ++i) {
+        sum += (long)get_nth_elem(l, i);
+    }
+    ns[1] = elapsed_ns(start) / numelems;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < numelems; ++i) {
+        sum += (long)get_nth_elem(l, (int)order[i]);
+    }
+    ns[2] = elapsed_ns(start) / numelems;
+    free_list(l);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long p = 0; p < numparts; ++p) {
+        List* part = list_init(LIST_PARTITION_CAPACITY);
+        for (long i = 0; i < SMALL_PARTITION; ++i) {
+            list_add_elem(part, (void*)i);
+        }
+        free_list(part);
+    }
+    ns[3] = elapsed_ns(start) / numparts;
+    sink = sum;
+}
+
+static void vector_run(double* ns) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Vector* v = vector_init();
+    for (long i = 0; i < numelems; ++i) {
+        vector_append(v, (void*)i);
+    }
+    ns[0] = elapsed_ns(start) / numelems;
+
+    long sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < vector_size(v); ++i) {
+        sum += (long)vector_get(v, i);
+    }
+    ns[1] = elapsed_ns(start) / numelems;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < numelems; ++i) {
+        sum += (long)vector_get(v, order[i]);
+    }
+    ns[2] = elapsed_ns(start) / numelems;
+    free_vector(v);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long p = 0; p < numparts; ++p) {
+        Vector* part = vector_init();
+        for (long i = 0; i < SMALL_PARTITION; ++i) {
+            vector_append(part, (void*)i);
+        }
+        free_vector(part);
+    }
+    ns[3] = elapsed_ns(start) / numparts;
+    sink = sum;
+}
+
+int main(int argc, char* argv[]) {
+    numelems = argc > 1 ? atol(argv[1]) : 10000000;
+    numparts = argc > 2 ? atol(argv[2]) : 1000000;
+    if (numelems < 1 || numelems > 1L << 30 || numparts < 1) {
+        printf("usage: %s [elements <= 2^30] [partitions]\n", argv[0]);
+        return 1;
+    }
+
+    order = malloc(sizeof(long) * numelems);
+    srand(42);
+    for (long i = 0; i < numelems; ++i) {
+        order[i] = ((long)rand() * RAND_MAX + rand()) % numelems;
+    }
+
+    double listns[4], vectorns[4];
+    list_run(listns);
+    vector_run(vectorns);
+
+    const char* names[] = {"append", "scan", "random", "partitions"};
+    printf("%ld elements, %ld partitions of %d (ns, lower is better)\n",
+           numelems, numparts, SMALL_PARTITION);
+    printf("%-10s %10s %10s\n", "scenario", "list", "vector");
+    for (int i = 0; i < 4; ++i) {
+        printf("%-10s %10.2f %10.2f\n", names[i], listns[i], vectorns[i]);
+    }
+
+    free(order);
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include <sys/time.h>
 #include <time.h>
 #include "lib.h"
+#include "minispark.h"
 
 #define SLEEPNSEC 1E8 // 100 ms
 
@@ -88,7 +89,7 @@ void *SleepSec2(void *arg, void *arg2, void* ctx) {
   (void)arg2;
   (void)ctx;
 
-  struct row* argcpy = malloc(sizeof(struct row));
+  struct row* argcpy = MS_Alloc(sizeof(struct row));
   memcpy(argcpy, arg, sizeof(struct row));
 
   SleepSec();
@@ -99,7 +100,7 @@ void *SleepSec2(void *arg, void *arg2, void* ctx) {
 void* SplitCols(void* arg) {
   char *line = (char*)arg;
 
-  struct row* row = malloc(sizeof(struct row));
+  struct row* row = MS_Alloc(sizeof(struct row));
   int nc = 0;
   char* ret;
   char* delim = " \t\n";
@@ -136,7 +137,7 @@ void* SumJoin(void* row1, void* row2, void* ctx) {
   struct row* row = NULL;
 
   if (!strcmp(data1->cols[c->keynum], data2->cols[c->keynum])) {
-    row = malloc(sizeof(struct row));
+    row = MS_Alloc(sizeof(struct row));
     int res = atoi(data1->cols[c->target]) + atoi(data2->cols[c->target]);
 
     strncpy(row->cols[0], data1->cols[c->keynum], MAXLEN);
@@ -148,11 +149,46 @@ void* SumJoin(void* row1, void* row2, void* ctx) {
 }
 
 
+// like SumJoin, but the new row is a copy of row1 with column m
+// replaced by the sum, so its result can be summed again: a reducer
+// for reduceByKey
+void* SumByKey(void* row1, void* row2, void* ctx) {
+  struct sumjoin_ctx* c = (struct sumjoin_ctx*)ctx;
+  struct row* data1 = (struct row*)row1;
+  struct row* data2 = (struct row*)row2;
+  struct row* row = NULL;
+
+  if (!strcmp(data1->cols[c->keynum], data2->cols[c->keynum])) {
+    row = MS_Alloc(sizeof(struct row));
+    int res = atoi(data1->cols[c->target]) + atoi(data2->cols[c->target]);
+
+    memcpy(row, data1, sizeof(struct row));
+    snprintf(row->cols[c->target], MAXLEN, "%d", res);
+  }
+
+  return (void*)row;
+}
+
 void *SumJoinSleep(void* row1, void* row2, void* ctx) {
   SleepSec();
   return SumJoin(row1, row2, ctx);
 }
 
+// hash the join key column of a row, so hashJoin only pairs up rows
+// whose keys are likely equal before calling SumJoin
+unsigned long SumJoinKeyHash(void* arg, void* ctx) {
+  struct sumjoin_ctx* c = (struct sumjoin_ctx*)ctx;
+
+  unsigned long hash = 5381;
+  char ch;
+  struct row* row = (struct row*)arg;
+  char* key = row->cols[c->keynum];
+  while ((ch = *key++) != '\0')
+    hash = hash * 33 + ch;
+
+  return hash;
+}
+
 // assign row to a partition based on the hash of column n
 unsigned long ColumnHashPartitioner(void* arg, int numpartitions, void* ctx) {
   struct colpart_ctx* c = (struct colpart_ctx*)ctx;
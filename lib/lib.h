@@ -6,7 +6,8 @@ void measureNumNops();
 
 int getNumThreads();
 // we statically allocate the number and length of columns to simplify
-// memory management.
+// memory management. The functions below return rows from MS_Alloc(), so
+// they are freed with their partition and must not be passed to free().
 struct row {
   char cols[MAXCOLS][MAXLEN];
   int ncols;
@@ -48,6 +49,19 @@ int StringContains(void* arg, void* needle);
 // returns: new `struct row` containing the key and sum
 void* SumJoin(void* row1, void* row2, void* ctx);
 
+// Reducers
+// row1, row2: `struct row` to be merged
+// ctx: key (column number), and target column to sum
+// returns: a copy of row1 whose target column is the sum of both, or
+// NULL if the keys differ
+void* SumByKey(void* row1, void* row2, void* ctx);
+
+// Key hashes
+// arg: `struct row`
+// ctx: `struct sumjoin_ctx`, the key column is hashed
+// returns: hash of the key, to be used with hashJoin and SumJoin
+unsigned long SumJoinKeyHash(void* arg, void* ctx);
+
 // Partitioners
 // arg: `struct row`
 // ctx: column number to hash, and number of output partitions
@@ -0,0 +1,88 @@
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static ArenaChunk* __new_chunk(size_t size) {
+    ArenaChunk* c = (ArenaChunk*)malloc(sizeof(ArenaChunk) + size);
+    if (c == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+Arena* arena_init() {
+    Arena* a = (Arena*)malloc(sizeof(Arena));
+    if (a == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    a->head = NULL;
+    a->tail = NULL;
+    a->size = 0;
+    return a;
+}
+
+void* arena_alloc(Arena* a, size_t size) {
+    // keep every allocation aligned like malloc()'s
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    a->size += size;
+
+    if (size > ARENA_CHUNK_SIZE / 4) {
+        // behind the head, so the rest of the head chunk is still used
+        ArenaChunk* c = __new_chunk(size);
+        c->used = size;
+        if (a->head == NULL) {
+            a->head = a->tail = c;
+        } else {
+            c->next = a->head->next;
+            a->head->next = c;
+            if (a->tail == a->head) {
+                a->tail = c;
+            }
+        }
+        return c->data;
+    }
+
+    if (a->head == NULL || a->head->size - a->head->used < size) {
+        ArenaChunk* c = __new_chunk(ARENA_CHUNK_SIZE);
+        c->next = a->head;
+        a->head = c;
+        if (a->tail == NULL) {
+            a->tail = c;
+        }
+    }
+    void* ptr = (char*)a->head->data + a->head->used;
+    a->head->used += size;
+    return ptr;
+}
+
+void arena_merge(Arena* into, Arena* from) {
+    if (from->head != NULL) {
+        if (into->head == NULL) {
+            into->head = from->head;
+        } else {
+            into->tail->next = from->head;
+        }
+        into->tail = from->tail;
+        into->size += from->size;
+    }
+    free(from);
+}
+
+void free_arena(Arena* a) {
+    if (a == NULL) {
+        return;
+    }
+    ArenaChunk* c = a->head;
+    while (c != NULL) {
+        ArenaChunk* next = c->next;
+        free(c);
+        c = next;
+    }
+    free(a);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file arena.h
+ * @author
+ * @brief Definition of a bump allocator whose memory is freed at once
+ * @version 0.1
+ * @date 2025-04-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE (64 << 10)
+
+/**
+ * @brief One block of memory of an arena.
+ */
+typedef struct ArenaChunk {
+    struct ArenaChunk* next; /**< Next chunk of the same arena, or NULL */
+    size_t size;             /**< Bytes of data */
+    size_t used;             /**< Bytes of data handed out */
+    max_align_t data[];      /**< The memory itself */
+} ArenaChunk;
+
+/**
+ * @brief Allocator that hands out memory from big chunks and never
+ * frees single allocations, only the whole arena.
+ *
+ * Arenas are not thread safe: each one is filled by one thread at a
+ * time.
+ */
+typedef struct Arena {
+    ArenaChunk* head; /**< Chunk allocations are taken from, or NULL */
+    ArenaChunk* tail; /**< Last chunk of the chain */
+    size_t size;      /**< Bytes handed out, over all chunks */
+} Arena;
+
+/**
+ * @brief Initialize an empty arena. No chunk is allocated until the
+ * first allocation.
+ *
+ * @return Arena* Pointer to the newly created arena.
+ */
+Arena* arena_init() __attribute__((warn_unused_result));
+
+/**
+ * @brief Allocate memory from the arena.
+ *
+ * Allocations bigger than a quarter of ARENA_CHUNK_SIZE get a chunk of
+ * their own.
+ *
+ * @param a Pointer to the arena.
+ * @param size Number of bytes, aligned for any type.
+ * @return void* The memory, valid until the arena is freed.
+ */
+void* arena_alloc(Arena* a, size_t size);
+
+/**
+ * @brief Move every chunk of "from" into "into" and free "from".
+ *
+ * @param into Pointer to the arena that takes over the memory.
+ * @param from Pointer to the arena to empty and free.
+ */
+void arena_merge(Arena* into, Arena* from);
+
+/**
+ * @brief Free the arena and all the memory allocated from it.
+ *
+ * @param a Pointer to the arena to free, or NULL.
+ */
+void free_arena(Arena* a);
+
+#endif  // !__ARENA_H__
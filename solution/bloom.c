@@ -0,0 +1,60 @@
+#include "bloom.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BITS_PER_WORD (8 * sizeof(unsigned long))
+
+// Spread the bits of "hash", which may come from a weak hash function,
+// over the whole word (the splitmix64 finalizer).
+static unsigned long __mix(unsigned long hash) {
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9UL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebUL;
+    return hash ^ (hash >> 31);
+}
+
+BloomFilter* bloom_init(long capacity) {
+    BloomFilter* b = (BloomFilter*)malloc(sizeof(BloomFilter));
+    if (b == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    b->numbits = BITS_PER_WORD;
+    while (b->numbits < (unsigned long)capacity * BLOOM_BITS_PER_ELEM) {
+        b->numbits *= 2;
+    }
+    b->bits = (unsigned long*)calloc(b->numbits / BITS_PER_WORD,
+                                     sizeof(unsigned long));
+    if (b->bits == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    return b;
+}
+
+void bloom_add(BloomFilter* b, unsigned long hash) {
+    unsigned long h1 = __mix(hash);
+    // odd, so the probes cover the whole power-of-two array
+    unsigned long h2 = __mix(h1) | 1;
+    for (int i = 0; i < BLOOM_NUMHASHES; ++i) {
+        unsigned long bit = (h1 + i * h2) & (b->numbits - 1);
+        b->bits[bit / BITS_PER_WORD] |= 1UL << (bit % BITS_PER_WORD);
+    }
+}
+
+int bloom_may_contain(BloomFilter* b, unsigned long hash) {
+    unsigned long h1 = __mix(hash);
+    unsigned long h2 = __mix(h1) | 1;
+    for (int i = 0; i < BLOOM_NUMHASHES; ++i) {
+        unsigned long bit = (h1 + i * h2) & (b->numbits - 1);
+        if (!(b->bits[bit / BITS_PER_WORD] & (1UL << (bit % BITS_PER_WORD)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void free_bloom(BloomFilter* b) {
+    free(b->bits);
+    free(b);
+}
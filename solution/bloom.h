@@ -0,0 +1,63 @@
+/**
+ * @file bloom.h
+ * @author
+ * @brief Definition of a Bloom filter over precomputed hashes
+ * @version 0.1
+ * @date 2025-04-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef __BLOOM_H__
+#define __BLOOM_H__
+
+#define BLOOM_BITS_PER_ELEM 10  // about 1% false positives
+#define BLOOM_NUMHASHES 7       // the best count for 10 bits per element
+
+/**
+ * @brief Set of hashes that may answer "maybe" for hashes never added.
+ *
+ * Each hash sets BLOOM_NUMHASHES bits, derived from it by double
+ * hashing, so lookups never miss a hash that was added.
+ */
+typedef struct BloomFilter {
+    unsigned long* bits;    /**< The bit array */
+    unsigned long numbits;  /**< Number of bits, a power of two */
+} BloomFilter;
+
+/**
+ * @brief Initialize an empty filter sized for "capacity" hashes.
+ *
+ * The filter does not grow: adding more hashes than "capacity" raises
+ * the false positive rate.
+ *
+ * @param capacity The expected number of hashes.
+ * @return BloomFilter* Pointer to the newly created filter.
+ */
+BloomFilter* bloom_init(long capacity) __attribute__((warn_unused_result));
+
+/**
+ * @brief Add a hash to the filter.
+ *
+ * @param b Pointer to the filter.
+ * @param hash The hash of a key.
+ */
+void bloom_add(BloomFilter* b, unsigned long hash);
+
+/**
+ * @brief Check whether a hash may have been added.
+ *
+ * @param b Pointer to the filter.
+ * @param hash The hash of a key.
+ * @return int 0 if "hash" was never added, else 1.
+ */
+int bloom_may_contain(BloomFilter* b, unsigned long hash);
+
+/**
+ * @brief Free the filter.
+ *
+ * @param b Pointer to the filter to free.
+ */
+void free_bloom(BloomFilter* b);
+
+#endif  // !__BLOOM_H__
@@ -0,0 +1,89 @@
+#include "deque.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+Deque* deque_init(int capacity) {
+    Deque* d = (Deque*)malloc(sizeof(Deque));
+    if (d == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    assert(capacity > 0);
+    d->top = 0;
+    d->bottom = 0;
+    d->capacity = capacity;
+    d->data = (void**)malloc(sizeof(void*) * capacity);
+    if (d->data == NULL) {
+        perror("malloc");
+        free((void*)d);
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&d->lock, NULL);
+    return d;
+}
+
+// must be called with d->lock held
+static void __deque_grow(Deque* d) {
+    int capacity = d->capacity * DEQUE_GROWTH_FACTOR;
+    void** new_data = (void**)malloc(sizeof(void*) * capacity);
+    if (new_data == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (long i = d->top; i < d->bottom; ++i) {
+        new_data[i % capacity] = d->data[i % d->capacity];
+    }
+    free((void*)d->data);
+    d->data = new_data;
+    d->capacity = capacity;
+}
+
+void deque_push_bottom(Deque* d, void* elem) {
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom - d->top == d->capacity) {
+        __deque_grow(d);
+    }
+    d->data[d->bottom % d->capacity] = elem;
+    ++d->bottom;
+    pthread_mutex_unlock(&d->lock);
+}
+
+void* deque_pop_bottom(Deque* d) {
+    void* elem = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) {
+        --d->bottom;
+        elem = d->data[d->bottom % d->capacity];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return elem;
+}
+
+void* deque_steal_top(Deque* d) {
+    void* elem = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) {
+        elem = d->data[d->top % d->capacity];
+        ++d->top;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return elem;
+}
+
+int deque_size(Deque* d) {
+    pthread_mutex_lock(&d->lock);
+    int size = (int)(d->bottom - d->top);
+    pthread_mutex_unlock(&d->lock);
+    return size;
+}
+
+void free_deque(Deque* d) {
+    if (d) {
+        pthread_mutex_destroy(&d->lock);
+        free((void*)d->data);
+        free((void*)d);
+    }
+}
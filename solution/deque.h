@@ -0,0 +1,85 @@
+/**
+ * @file deque.h
+ * @author
+ * @brief Definition of a double-ended work queue used for work stealing
+ * @version 0.1
+ * @date 2025-04-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef __DEQUE_H__
+#define __DEQUE_H__
+
+#include <pthread.h>
+
+#define DEQUE_GROWTH_FACTOR 2
+
+/**
+ * @brief Work-stealing deque.
+ *
+ * Each worker owns one deque per priority bucket, see pqueue.h. The
+ * owner pushes and pops at the bottom (LIFO, so the task it just
+ * unblocked runs next while its inputs are still in cache) and thieves
+ * take from the top (FIFO, the oldest task). Every operation takes the deque's own lock, so workers only
+ * contend with each other when one of them is stealing.
+ */
+typedef struct Deque {
+    long top;     /**< Index of the oldest element, taken by thieves */
+    long bottom;  /**< One past the newest element, used by the owner */
+    int capacity; /**< Number of slots in the ring buffer */
+    void** data;  /**< Ring buffer of generic pointers */
+    pthread_mutex_t lock;
+} Deque;
+
+/**
+ * @brief Initialize a new deque with a given initial capacity.
+ *
+ * @param capacity The initial capacity, grown by DEQUE_GROWTH_FACTOR
+ * whenever the deque is full.
+ * @return Deque* Pointer to the newly created deque.
+ */
+Deque* deque_init(int capacity) __attribute__((warn_unused_result));
+
+/**
+ * @brief Push an element at the bottom (owner side) of the deque.
+ *
+ * @param d Pointer to the deque.
+ * @param elem Generic pointer to the element to add.
+ */
+void deque_push_bottom(Deque* d, void* elem);
+
+/**
+ * @brief Pop the newest element from the bottom (owner side).
+ *
+ * @param d Pointer to the deque.
+ * @return The newest element, or NULL if the deque is empty.
+ */
+void* deque_pop_bottom(Deque* d);
+
+/**
+ * @brief Steal the oldest element from the top (thief side).
+ *
+ * @param d Pointer to the deque.
+ * @return The oldest element, or NULL if the deque is empty.
+ */
+void* deque_steal_top(Deque* d);
+
+/**
+ * @brief Number of elements currently in the deque.
+ *
+ * @param d Pointer to the deque.
+ * @return int The number of elements.
+ */
+int deque_size(Deque* d);
+
+/**
+ * @brief Free the deque structure.
+ *
+ * Like free_list(), the elements themselves are not freed.
+ *
+ * @param d Pointer to the deque to free.
+ */
+void free_deque(Deque* d);
+
+#endif  // !__DEQUE_H__
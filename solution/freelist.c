@@ -0,0 +1,122 @@
+#include "freelist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// A free object keeps the next one of its chain in its first bytes.
+#define __NEXT(obj) (*(void**)(obj))
+
+// Carve a new slab into free objects, with fl->lock held.
+static void __new_slab(FreeList* fl) {
+    // the slab's first bytes chain it to the others
+    char* slab =
+        (char*)malloc(sizeof(max_align_t) + fl->size * FREELIST_SLAB_OBJECTS);
+    if (slab == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    __NEXT(slab) = fl->slabs;
+    fl->slabs = slab;
+
+    char* obj = slab + sizeof(max_align_t);
+    for (int i = 0; i < FREELIST_SLAB_OBJECTS; ++i, obj += fl->size) {
+        __NEXT(obj) = fl->head;
+        fl->head = obj;
+    }
+}
+
+FreeList* freelist_init(size_t size) {
+    FreeList* fl = (FreeList*)malloc(sizeof(FreeList));
+    if (fl == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    // keep every object aligned like malloc()'s, and big enough to chain
+    if (size < sizeof(void*)) {
+        size = sizeof(void*);
+    }
+    fl->size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    fl->head = NULL;
+    fl->slabs = NULL;
+    pthread_mutex_init(&fl->lock, NULL);
+    return fl;
+}
+
+void* freelist_get(FreeList* fl, FreeCache* cache) {
+    if (cache && cache->head) {
+        void* obj = cache->head;
+        cache->head = __NEXT(obj);
+        --cache->count;
+        return obj;
+    }
+
+    pthread_mutex_lock(&fl->lock);
+    if (fl->head == NULL) {
+        __new_slab(fl);
+    }
+    void* obj = fl->head;
+    fl->head = __NEXT(obj);
+    if (cache) {
+        // detach up to a batch more behind it for the cache
+        void* last = NULL;
+        int count = 0;
+        for (void* o = fl->head; o && count < FREELIST_BATCH; o = __NEXT(o)) {
+            last = o;
+            ++count;
+        }
+        if (last) {
+            cache->head = fl->head;
+            cache->count = count;
+            fl->head = __NEXT(last);
+            __NEXT(last) = NULL;
+        }
+    }
+    pthread_mutex_unlock(&fl->lock);
+    return obj;
+}
+
+void freelist_put(FreeList* fl, FreeCache* cache, void* obj) {
+    if (cache == NULL) {
+        pthread_mutex_lock(&fl->lock);
+        __NEXT(obj) = fl->head;
+        fl->head = obj;
+        pthread_mutex_unlock(&fl->lock);
+        return;
+    }
+
+    __NEXT(obj) = cache->head;
+    cache->head = obj;
+    if (++cache->count < 2 * FREELIST_BATCH) {
+        return;
+    }
+    // hand back the older half, found before taking the lock
+    void* last = cache->head;
+    for (int i = 1; i < FREELIST_BATCH; ++i) {
+        last = __NEXT(last);
+    }
+    void* first = __NEXT(last);
+    __NEXT(last) = NULL;
+    cache->count = FREELIST_BATCH;
+
+    void* tail = first;
+    while (__NEXT(tail)) {
+        tail = __NEXT(tail);
+    }
+    pthread_mutex_lock(&fl->lock);
+    __NEXT(tail) = fl->head;
+    fl->head = first;
+    pthread_mutex_unlock(&fl->lock);
+}
+
+void free_freelist(FreeList* fl) {
+    if (fl == NULL) {
+        return;
+    }
+    while (fl->slabs) {
+        void* next = __NEXT(fl->slabs);
+        free(fl->slabs);
+        fl->slabs = next;
+    }
+    pthread_mutex_destroy(&fl->lock);
+    free(fl);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file freelist.h
+ * @author
+ * @brief Definition of a pool of fixed-size objects that are recycled
+ * instead of freed
+ * @version 0.1
+ * @date 2025-04-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef __FREELIST_H__
+#define __FREELIST_H__
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define FREELIST_SLAB_OBJECTS 256 /**< Objects allocated at once */
+#define FREELIST_BATCH 64         /**< Objects moved to or from a cache */
+
+/**
+ * @brief Free objects held by one thread, taken and returned without
+ * locking the free list.
+ */
+typedef struct FreeCache {
+    void* head; /**< Chain of free objects, or NULL */
+    int count;  /**< Objects in the chain */
+} FreeCache;
+
+/**
+ * @brief Thread safe pool of objects of one size. Objects are carved
+ * from slabs that are only freed with the whole pool, and a returned
+ * object is handed out again before any new one is carved.
+ */
+typedef struct FreeList {
+    size_t size;          /**< Bytes per object, aligned like malloc()'s */
+    void* head;           /**< Free objects not cached by any thread */
+    void* slabs;          /**< Chain of every slab allocated */
+    pthread_mutex_t lock; /**< Guards head and slabs */
+} FreeList;
+
+/**
+ * @brief Initialize an empty pool. No slab is allocated until the first
+ * object is taken.
+ *
+ * @param size Number of bytes of each object.
+ * @return FreeList* Pointer to the newly created pool.
+ */
+FreeList* freelist_init(size_t size) __attribute__((warn_unused_result));
+
+/**
+ * @brief Take an object from the pool, uninitialized.
+ *
+ * With a cache, the pool is only locked to refill it with
+ * FREELIST_BATCH objects at once.
+ *
+ * @param fl Pointer to the pool.
+ * @param cache Pointer to the calling thread's cache, or NULL.
+ * @return void* The object.
+ */
+void* freelist_get(FreeList* fl, FreeCache* cache);
+
+/**
+ * @brief Return an object to the pool.
+ *
+ * With a cache, the pool is only locked once the cache holds twice
+ * FREELIST_BATCH objects, to take back half of them.
+ *
+ * @param fl Pointer to the pool the object was taken from.
+ * @param cache Pointer to the calling thread's cache, or NULL.
+ * @param obj The object.
+ */
+void freelist_put(FreeList* fl, FreeCache* cache, void* obj);
+
+/**
+ * @brief Free the pool and every object ever taken from it. Caches
+ * filled from it must not be used anymore.
+ *
+ * @param fl Pointer to the pool to free, or NULL.
+ */
+void free_freelist(FreeList* fl);
+
+#endif  // !__FREELIST_H__
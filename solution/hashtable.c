@@ -0,0 +1,113 @@
+#include "hashtable.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void* __checked_malloc(size_t size) {
+    void* ptr = malloc(size);
+    if (ptr == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+// Growing by HASHTABLE_GROWTH_FACTOR would overflow the byte count of
+// an array of "count" elements of "size" bytes.
+static int __too_big(long count, size_t size) {
+    return count > LONG_MAX / HASHTABLE_GROWTH_FACTOR / (long)size;
+}
+
+static void __rehash(HashTable* t, long numbuckets) {
+    free((void*)t->buckets);
+    t->buckets = (long*)__checked_malloc(sizeof(long) * numbuckets);
+    t->numbuckets = numbuckets;
+    for (long i = 0; i < numbuckets; ++i) {
+        t->buckets[i] = -1;
+    }
+    // relinking in insertion order keeps the newest entry first
+    for (long i = 0; i < t->size; ++i) {
+        long b = (long)(t->entries[i].hash & (unsigned long)(numbuckets - 1));
+        t->entries[i].next = t->buckets[b];
+        t->buckets[b] = i;
+    }
+}
+
+HashTable* hashtable_init(long capacity) {
+    HashTable* t = (HashTable*)__checked_malloc(sizeof(HashTable));
+
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    if (__too_big(capacity, sizeof(HashEntry))) {
+        fprintf(stderr, "hashtable_init: table is too big\n");
+        exit(EXIT_FAILURE);
+    }
+    long numbuckets = 1;
+    while (numbuckets < capacity) {
+        numbuckets *= 2;
+    }
+    t->size = 0;
+    t->capacity = capacity;
+    t->entries = (HashEntry*)__checked_malloc(sizeof(HashEntry) * capacity);
+    t->buckets = NULL;
+    __rehash(t, numbuckets);
+    return t;
+}
+
+long hashtable_insert(HashTable* t, unsigned long hash, void* value) {
+    if (t->size == t->capacity) {
+        if (__too_big(t->capacity, sizeof(HashEntry))) {
+            fprintf(stderr, "hashtable_insert: table is full\n");
+            exit(EXIT_FAILURE);
+        }
+        long capacity = t->capacity * HASHTABLE_GROWTH_FACTOR;
+        HashEntry* entries =
+            (HashEntry*)realloc(t->entries, sizeof(HashEntry) * capacity);
+        if (entries == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        t->entries = entries;
+        t->capacity = capacity;
+    }
+
+    long idx = t->size++;
+    long b = (long)(hash & (unsigned long)(t->numbuckets - 1));
+    t->entries[idx].hash = hash;
+    t->entries[idx].value = value;
+    t->entries[idx].next = t->buckets[b];
+    t->buckets[b] = idx;
+
+    if (t->size > t->numbuckets) {
+        __rehash(t, t->numbuckets * HASHTABLE_GROWTH_FACTOR);
+    }
+    return idx;
+}
+
+static long __skip_to_hash(HashTable* t, long idx, unsigned long hash) {
+    while (idx != -1 && t->entries[idx].hash != hash) {
+        idx = t->entries[idx].next;
+    }
+    return idx;
+}
+
+long hashtable_find(HashTable* t, unsigned long hash) {
+    long b = (long)(hash & (unsigned long)(t->numbuckets - 1));
+    return __skip_to_hash(t, t->buckets[b], hash);
+}
+
+long hashtable_find_next(HashTable* t, long idx) {
+    assert(idx >= 0 && idx < t->size);
+    return __skip_to_hash(t, t->entries[idx].next, t->entries[idx].hash);
+}
+
+void free_hashtable(HashTable* t) {
+    if (t) {
+        free((void*)t->buckets);
+        free((void*)t->entries);
+        free((void*)t);
+    }
+}
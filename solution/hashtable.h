@@ -0,0 +1,93 @@
+/**
+ * @file hashtable.h
+ * @author
+ * @brief Definition of a chained hash table keyed by precomputed hashes
+ * @version 0.1
+ * @date 2025-04-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef __HASHTABLE_H__
+#define __HASHTABLE_H__
+
+#define HASHTABLE_GROWTH_FACTOR 2
+
+/**
+ * @brief One element of the table.
+ *
+ * Entries live in one array in insertion order and are chained per
+ * bucket through array indices, so growing the table never moves an
+ * element out from under a caller holding its index.
+ */
+typedef struct HashEntry {
+    unsigned long hash; /**< Hash the element was inserted with */
+    void* value;        /**< Generic pointer to the element */
+    long next;          /**< Next entry of the same bucket, or -1 */
+} HashEntry;
+
+/**
+ * @brief Hash table of generic pointers.
+ *
+ * The table stores hashes, not keys: elements whose hashes are equal
+ * are all returned by a lookup and the caller compares the actual keys.
+ * Within a bucket, the most recently inserted entry comes first.
+ */
+typedef struct HashTable {
+    long size;          /**< Number of entries */
+    long capacity;      /**< Number of allocated entries */
+    long numbuckets;    /**< Number of buckets, a power of two */
+    long* buckets;      /**< First entry of each bucket, or -1 */
+    HashEntry* entries; /**< Entries in insertion order */
+} HashTable;
+
+/**
+ * @brief Initialize a new table sized for "capacity" entries.
+ *
+ * The table grows by HASHTABLE_GROWTH_FACTOR when it holds more entries
+ * than buckets, so a good estimate avoids rehashing. Exits if the grown
+ * table would not fit in memory addressable by a long.
+ *
+ * @param capacity The expected number of entries.
+ * @return HashTable* Pointer to the newly created table.
+ */
+HashTable* hashtable_init(long capacity) __attribute__((warn_unused_result));
+
+/**
+ * @brief Insert an element under a hash.
+ *
+ * @param t Pointer to the table.
+ * @param hash The hash of the element's key.
+ * @param value Generic pointer to the element.
+ * @return long Index of the new entry in `entries`.
+ */
+long hashtable_insert(HashTable* t, unsigned long hash, void* value);
+
+/**
+ * @brief Find the first entry inserted under "hash".
+ *
+ * @param t Pointer to the table.
+ * @param hash The hash to look up.
+ * @return long Index of the entry in `entries`, or -1 if there is none.
+ */
+long hashtable_find(HashTable* t, unsigned long hash);
+
+/**
+ * @brief Find the next entry with the same hash as entry "idx".
+ *
+ * @param t Pointer to the table.
+ * @param idx Index returned by hashtable_find() or hashtable_find_next().
+ * @return long Index of the next entry, or -1 if there is none.
+ */
+long hashtable_find_next(HashTable* t, long idx);
+
+/**
+ * @brief Free the table.
+ *
+ * Like free_list(), the elements themselves are not freed.
+ *
+ * @param t Pointer to the table to free.
+ */
+void free_hashtable(HashTable* t);
+
+#endif  // !__HASHTABLE_H__
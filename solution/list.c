@@ -1,11 +1,12 @@
 #include "list.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-List* list_init(int capacity) {
+List* list_init(long capacity) {
     List* l = (List*)malloc(sizeof(List));
     if (l == NULL) {
         perror("malloc");
@@ -23,13 +24,13 @@ List* list_init(int capacity) {
         free((void*)l);
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < capacity; ++i) {
+    for (long i = 0; i < capacity; ++i) {
         l->data[i] = NULL;
     }
     return l;
 }
 
-void __grow_capacity(List* l, int capacity) {
+void __grow_capacity(List* l, long capacity) {
     void** new_data = (void**)malloc(sizeof(void*) * capacity);
     if (new_data == NULL) {
         perror("malloc");
@@ -37,7 +38,7 @@ void __grow_capacity(List* l, int capacity) {
     }
     seek_to_start(l);
     void* data = NULL;
-    int idx = 0;
+    long idx = 0;
     while ((data = next(l)) != NULL) {
         new_data[idx++] = data;
     }
@@ -53,6 +54,11 @@ void list_add_elem(List* l, void* elem) {
         return;
     }
     if (l->size == l->capacity) {
+        if (l->capacity >
+            LONG_MAX / LIST_GROWTH_FACTOR / (long)sizeof(void*)) {
+            fprintf(stderr, "list_add_elem: list is full\n");
+            exit(EXIT_FAILURE);
+        }
         __grow_capacity(l, l->capacity * LIST_GROWTH_FACTOR);
     }
     l->data[(l->start + l->size) % l->capacity] = elem;
@@ -76,7 +82,7 @@ List* list_reverse(List* l) {
         return NULL;
     }
     List* new_list = list_init(l->capacity);
-    for (int i = l->size - 1; i >= 0; --i) {
+    for (long i = l->size - 1; i >= 0; --i) {
         list_add_elem(new_list, l->data[(l->start + i) % l->capacity]);
     }
 
@@ -120,21 +126,24 @@ void free_list(List* l) {
     }
 }
 
-void* get_nth_elem(List* l, int n) {
+void* get_nth_elem(List* l, long n) {
     return l->data[(l->start + n) % l->capacity];
 }
 
-int get_size(List* l) {
+long get_size(List* l) {
     return l->size;
 }
 
-void list_insert_at(List* l, void* elem, int idx) {
+void list_insert_at(List* l, void* elem, long idx) {
     if (l) {
         if (l->capacity <= idx) {
             return;
         }
-        if (l->data[((l->start) + idx) % l->capacity] == NULL) {
+        void* old = l->data[((l->start) + idx) % l->capacity];
+        if (old == NULL && elem != NULL) {
             ++(l->size);
+        } else if (old != NULL && elem == NULL) {
+            --(l->size);
         }
         l->data[((l->start) + idx) % l->capacity] = elem;
     }
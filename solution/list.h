@@ -20,10 +20,10 @@
  * its current size (number of elements) and its capacity.
  */
 typedef struct List {
-    int size;     /**< Current number of elements in the list */
-    int capacity; /**< Maximum number of elements before needing to grow */
-    int pos;      /**< Internal iterator position used for traversal */
-    int start;    /**< Index of the front element in the ring buffer. */
+    long size;     /**< Current number of elements in the list */
+    long capacity; /**< Maximum number of elements before needing to grow */
+    long pos;      /**< Internal iterator position used for traversal */
+    long start;    /**< Index of the front element in the ring buffer. */
     void** data;  /**< Pointer to an array of generic pointers */
 } List;
 
@@ -36,14 +36,15 @@ typedef struct List {
  * @param capacity The initial capacity for the list.
  * @return List* Pointer to the newly created list.
  */
-List* list_init(int capacity) __attribute__((warn_unused_result));
+List* list_init(long capacity) __attribute__((warn_unused_result));
 
 /**
  * @brief Add an element to the list.
  *
  * Inserts a new element into the list. If the list has reached its current
  * capacity, the internal storage is automatically increase by
- * LIST_GROWTH_FACTOR.
+ * LIST_GROWTH_FACTOR. Exits if the grown storage would not fit in
+ * memory addressable by a long.
  *
  * @param l Pointer to the list.
  * @param elem Generic pointer to the element to add.
@@ -118,10 +119,18 @@ void seek_to_start(List* l);
  */
 void free_list(List* l);
 
-void* get_nth_elem(List* l, int n);
+void* get_nth_elem(List* l, long n);
 
-int get_size(List* l);
+long get_size(List* l);
 
-void list_insert_at(List* l, void* elem, int idx);
+/**
+ * @brief Store an element at a given index, counting only the non-NULL
+ * elements in the size: storing NULL clears the index.
+ *
+ * @param l Pointer to the list.
+ * @param elem The element to store, or NULL.
+ * @param idx Index below the list's capacity, else nothing is stored.
+ */
+void list_insert_at(List* l, void* elem, long idx);
 
 #endif  // !__LIST_H__
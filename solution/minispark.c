@@ -6,13 +6,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 
+#include "arena.h"
+#include "bloom.h"
+#include "hashtable.h"
 #include "list.h"
 #include "thread_pool.h"
 
 #define LIST_INIT_CAPACITY 10
 #define CONTENT_INIT_CAPACITY 1024
+#define SHAPE_SLOTS 256
 
 const char *LOG_FILE = "metrics.log";
 
@@ -20,6 +25,45 @@ MetricQueue *metric_queue;
 
 pthread_t metric_thread;
 
+// Run times of all tasks so far per transformation, in usec, used to
+// estimate RDDs that have not run a task yet.
+static long transTime[FILE_BACKED + 1];
+static int transTimed[FILE_BACKED + 1];
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Run times of all tasks so far per stage shape, see stage_shape(), so
+// that a new DAG built like an earlier one is known to be cheap or not.
+// An open-addressed table under statsLock; shape 0 marks a free slot.
+typedef struct {
+    unsigned long shape;
+    long time;
+    long timed;
+} ShapeTime;
+static ShapeTime shapeTimes[SHAPE_SLOTS];
+
+// Every RDD created so far, freed by MS_TearDown().
+static List *allRDDs = NULL;
+static pthread_mutex_t allRDDsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// MS_Alloc() state: the arena of the task running on this thread, if
+// it has allocated yet, and the arena of everything allocated outside
+// tasks.
+static __thread int inTask = 0;
+static __thread Arena *taskArena = NULL;
+static Arena *sessionArena = NULL;
+static pthread_mutex_t sessionArenaLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Serializes the planning of concurrent jobs, and is broadcast whenever
+// an RDD has all its partitions stored.
+static pthread_mutex_t computedLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t computedCond = PTHREAD_COND_INITIALIZER;
+
+// Jobs submitted over a stage another job was computing, in submission
+// order, chained through Job::deferred. Guarded by computedLock.
+static Job *deferredJobs = NULL;
+
+static void plan_deferred(void);
+
 // Working with metrics...
 // Recording the current time in a `struct timespec`:
 //    clock_gettime(CLOCK_MONOTONIC, &metric->created);
@@ -61,10 +105,46 @@ RDD *create_rdd(int numdeps, Transform t, void *fn, ...) {
     rdd->numdependencies = numdeps;
     rdd->trans = t;
     rdd->fn = fn;
+    rdd->ctx = NULL;
+    rdd->keyhash = NULL;
+    rdd->init = NULL;
     rdd->partitions = NULL;
+    rdd->filenames = NULL;
     rdd->numpartitions = maxpartitions;
     rdd->numComputed = 0;
+    rdd->job = NULL;
+    rdd->dependents = NULL;
+    rdd->pendingDeps = NULL;
+    rdd->fused = 0;
+    rdd->numfused = 0;
+    rdd->shape = 0;
+    rdd->idempotent = 0;
+    rdd->priority = 0;
+    rdd->taskTime = 0;
+    rdd->numTimed = 0;
+    rdd->timeSeed = 1;
+    rdd->shuffle = NULL;
+    rdd->numShuffled = 0;
+    rdd->samples = NULL;
+    rdd->bounds = NULL;
+    rdd->numbounds = 0;
+    rdd->broadcast = NULL;
+    rdd->bloom = NULL;
+    rdd->arenas = NULL;
+    rdd->shared = NULL;
+    rdd->readers = NULL;
+    rdd->numheld = 0;
+    rdd->owned = 0;
+    rdd->destroy = NULL;
     pthread_mutex_init(&(rdd->partitionListLock), NULL);
+    pthread_mutex_init(&(rdd->buildLock), NULL);
+
+    pthread_mutex_lock(&allRDDsLock);
+    if (allRDDs == NULL) {
+        allRDDs = list_init(LIST_INIT_CAPACITY);
+    }
+    list_add_elem(allRDDs, rdd);
+    pthread_mutex_unlock(&allRDDsLock);
     return rdd;
 }
 
@@ -81,9 +161,41 @@ RDD *filter(RDD *dep, Filter fn, void *ctx) {
     return rdd;
 }
 
+RDD *speculate(RDD *rdd) {
+    rdd->idempotent = 1;
+    return rdd;
+}
+
+RDD *ownElements(RDD *rdd, Destructor fn) {
+    rdd->owned = 1;
+    rdd->destroy = fn;
+    return rdd;
+}
+
 RDD *partitionBy(RDD *dep, Partitioner fn, int numpartitions, void *ctx) {
     RDD *rdd = create_rdd(1, PARTITIONBY, fn, dep);
-    rdd->partitions = list_init(numpartitions);
+    rdd->numpartitions = numpartitions;
+    rdd->ctx = ctx;
+    return rdd;
+}
+
+RDD *aggregateByKey(RDD *dep, Mapper init, Reducer fn, Hasher hash,
+                    int numpartitions, void *ctx) {
+    RDD *rdd = create_rdd(1, AGGREGATEBYKEY, fn, dep);
+    rdd->init = init;
+    rdd->keyhash = hash;
+    rdd->numpartitions = numpartitions;
+    rdd->ctx = ctx;
+    return rdd;
+}
+
+RDD *reduceByKey(RDD *dep, Reducer fn, Hasher hash, int numpartitions,
+                 void *ctx) {
+    return aggregateByKey(dep, NULL, fn, hash, numpartitions, ctx);
+}
+
+RDD *sortBy(RDD *dep, Comparator fn, int numpartitions, void *ctx) {
+    RDD *rdd = create_rdd(1, SORTBY, fn, dep);
     rdd->numpartitions = numpartitions;
     rdd->ctx = ctx;
     return rdd;
@@ -95,6 +207,28 @@ RDD *join(RDD *dep1, RDD *dep2, Joiner fn, void *ctx) {
     return rdd;
 }
 
+RDD *hashJoin(RDD *dep1, RDD *dep2, Joiner fn, Hasher hash, void *ctx) {
+    RDD *rdd = join(dep1, dep2, fn, ctx);
+    rdd->keyhash = hash;
+    return rdd;
+}
+
+RDD *broadcastJoin(RDD *dep1, RDD *dep2, Joiner fn, Hasher hash, void *ctx) {
+    RDD *rdd = create_rdd(2, BROADCASTJOIN, fn, dep1, dep2);
+    rdd->numpartitions = dep1->numpartitions;
+    rdd->keyhash = hash;
+    rdd->ctx = ctx;
+    return rdd;
+}
+
+RDD *semiJoinFilter(RDD *dep, RDD *keys, Hasher hash, void *ctx) {
+    RDD *rdd = create_rdd(2, SEMIJOIN, NULL, dep, keys);
+    rdd->numpartitions = dep->numpartitions;
+    rdd->keyhash = hash;
+    rdd->ctx = ctx;
+    return rdd;
+}
+
 /* A special mapper */
 void *identity(void *arg) {
     return arg;
@@ -103,8 +237,8 @@ void *identity(void *arg) {
 /* Special RDD constructor.
  * By convention, this is how we read from input files. */
 RDD *RDDFromFiles(char **filenames, int numfiles) {
-    RDD *rdd = malloc(sizeof(RDD));
-    rdd->partitions = list_init(numfiles);
+    RDD *rdd = create_rdd(0, FILE_BACKED, (void *)identity);
+    rdd->partitions = list_init(max(numfiles, 1));
 
     for (int i = 0; i < numfiles; i++) {
         FILE *fp = fopen(filenames[i], "r");
@@ -115,54 +249,1266 @@ RDD *RDDFromFiles(char **filenames, int numfiles) {
         list_add_elem(rdd->partitions, fp);
     }
 
-    rdd->numdependencies = 0;
-    rdd->trans = FILE_BACKED;
-    rdd->fn = (void *)identity;
     rdd->numpartitions = numfiles;
-    rdd->numComputed = 0;
-    pthread_mutex_init(&(rdd->partitionListLock), NULL);
+    // the opened files are the partitions, so there is nothing to compute
+    rdd->numComputed = numfiles;
     return rdd;
 }
 
-static List *get_tasks_list(RDD *rdd) {
+RDD *RDDFromTextFiles(char **filenames, int numfiles) {
+    RDD *rdd = RDDFromFiles(filenames, numfiles);
+    rdd->filenames = (char **)malloc(sizeof(char *) * max(numfiles, 1));
+    for (int i = 0; i < numfiles; i++) {
+        rdd->filenames[i] = strdup(filenames[i]);
+    }
+    return rdd;
+}
+
+static int is_computed(RDD *rdd) {
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    int computed = rdd->numComputed == rdd->numpartitions;
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+    return computed;
+}
+
+// Whether every RDD of the narrow stage topped by "top" may run twice on
+// the same input. Files are read through one shared FILE*, so stages
+// reading them are never run twice.
+static int stage_is_idempotent(RDD *top) {
+    if (top->trans != MAP && top->trans != FILTER) {
+        return 0;
+    }
+    RDD *rdd = top;
+    for (int i = 0; i <= top->numfused; ++i) {
+        if (!rdd->idempotent) {
+            return 0;
+        }
+        rdd = rdd->dependencies[0];
+    }
+    return rdd->trans != FILE_BACKED;
+}
+
+static void init_task(Task *task, TaskMetric *metric, RDD *rdd, int pnum,
+                      TaskKind kind) {
+    task->rdd = rdd;
+    task->pnum = pnum;
+    task->kind = kind;
+    task->morsels = NULL;
+    task->morsel = 0;
+    task->priority = rdd->priority;
+    // the last morsel to finish frees the Morsels a copy would still read
+    task->speculative = kind != SHUFFLE_MAP_TASK && kind != MORSEL_TASK &&
+                        stage_is_idempotent(rdd);
+    atomic_init(&task->copied, 0);
+    atomic_init(&task->done, 0);
+    task->original = NULL;
+    task->job = rdd->job;
+    task->cancel = NULL;
+    task->take = NULL;
+    task->output = NULL;
+    task->metric = metric;
+    metric->pnum = pnum;
+    metric->rdd = rdd;
+    clock_gettime(CLOCK_MONOTONIC, &metric->created);
+}
+
+static Task *new_task(RDD *rdd, int pnum, TaskKind kind) {
+    Task *task = thread_pool_new_task();
+    init_task(task, task->metric, rdd, pnum, kind);
+    return task;
+}
+
+static void submit_task(RDD *rdd, int pnum, TaskKind kind) {
+    thread_pool_submit(new_task(rdd, pnum, kind));
+}
+
+// Measure the input of partition "pnum" of "rdd", whose input
+// partitions are stored. Returns how many units of "*size" make one
+// morsel, or 0 if the partition is computed by a single task.
+static long morsel_units(RDD *rdd, int pnum, long *size) {
+    if (rdd->trans == JOIN && rdd->keyhash == NULL) {
+        // split the outer loop, keeping the Joiner calls per morsel even
+        Vector *left = get_nth_elem(rdd->dependencies[0]->partitions, pnum);
+        Vector *right = get_nth_elem(rdd->dependencies[1]->partitions, pnum);
+        *size = vector_size(left);
+        return vector_size(right) == 0
+                   ? 0
+                   : max(MORSEL_JOIN_PAIRS / vector_size(right), 1);
+    }
+    if (rdd->trans != MAP && rdd->trans != FILTER && rdd->trans != SEMIJOIN) {
+        return 0;
+    }
+
+    RDD *first = rdd;
+    for (int i = 0; i < rdd->numfused; ++i) {
+        first = first->dependencies[0];
+    }
+    RDD *source = first->dependencies[0];
+    if (source->trans != FILE_BACKED) {
+        *size = vector_size(get_nth_elem(source->partitions, pnum));
+        return MORSEL_SIZE;
+    }
+    if (source->filenames == NULL || first->trans != MAP) {
+        return 0;
+    }
+    struct stat st;
+    FILE *fp = (FILE *)get_nth_elem(source->partitions, pnum);
+    if (fstat(fileno(fp), &st) == -1) {
+        return 0;
+    }
+    *size = st.st_size;
+    return MORSEL_BYTES;
+}
+
+// Count the key hashes of JOIN_SAMPLE_SIZE evenly spaced rows of "in",
+// or of all of them, into a table whose values are the counts.
+static HashTable *sample_keys(RDD *rdd, Vector *in) {
+    long size = vector_size(in);
+    long numsamples = size < JOIN_SAMPLE_SIZE ? size : JOIN_SAMPLE_SIZE;
+    HashTable *counts = hashtable_init(numsamples);
+    for (long i = 0; i < numsamples; ++i) {
+        void *elem = vector_get(in, (2 * i + 1) * size / (2 * numsamples));
+        unsigned long hash = rdd->keyhash(elem, rdd->ctx);
+        long idx = hashtable_find(counts, hash);
+        if (idx == -1) {
+            hashtable_insert(counts, hash, (void *)1L);
+        } else {
+            counts->entries[idx].value =
+                (void *)((long)counts->entries[idx].value + 1);
+        }
+    }
+    return counts;
+}
+
+// Number of morsels of partition "pnum" of hash join "rdd": one per
+// MORSEL_JOIN_PAIRS Joiner calls, as estimated from samples of both
+// inputs, but at most one per probe row. The probe side is picked like
+// compute_hash_join() does, and its size goes to "*size". Keys
+// estimated to make a morsel's worth of calls on their own go to
+// "*hot", which stays NULL if there are none.
+static long join_morsels(RDD *rdd, int pnum, long *size, HashTable **hot) {
+    Vector *left = get_nth_elem(rdd->dependencies[0]->partitions, pnum);
+    Vector *right = get_nth_elem(rdd->dependencies[1]->partitions, pnum);
+    Vector *build = vector_size(left) < vector_size(right) ? left : right;
+    Vector *probe = build == left ? right : left;
+    *size = vector_size(probe);
+    *hot = NULL;
+    if (vector_size(build) == 0 || vector_size(probe) == 0) {
+        return 1;
+    }
+
+    HashTable *probeKeys = sample_keys(rdd, probe);
+    HashTable *buildKeys = sample_keys(rdd, build);
+    double probeScale =
+        (double)vector_size(probe) /
+        (vector_size(probe) < JOIN_SAMPLE_SIZE ? vector_size(probe)
+                                               : JOIN_SAMPLE_SIZE);
+    double buildScale =
+        (double)vector_size(build) /
+        (vector_size(build) < JOIN_SAMPLE_SIZE ? vector_size(build)
+                                               : JOIN_SAMPLE_SIZE);
+    double calls = 0;
+    for (long i = 0; i < probeKeys->size; ++i) {
+        HashEntry *key = &probeKeys->entries[i];
+        long match = hashtable_find(buildKeys, key->hash);
+        if (match == -1) {
+            continue;
+        }
+        double pairs = (long)key->value * probeScale *
+                       (long)buildKeys->entries[match].value * buildScale;
+        calls += pairs;
+        if (pairs >= MORSEL_JOIN_PAIRS) {
+            if (*hot == NULL) {
+                *hot = hashtable_init(LIST_INIT_CAPACITY);
+            }
+            hashtable_insert(*hot, key->hash, NULL);
+        }
+    }
+    free_hashtable(probeKeys);
+    free_hashtable(buildKeys);
+
+    long nummorsels = (long)(calls / MORSEL_JOIN_PAIRS) + 1;
+    return nummorsels < *size ? nummorsels : *size;
+}
+
+// Submit the task computing partition "pnum" of "rdd", or one task per
+// morsel when its input is bigger than one morsel.
+static void submit_partition(RDD *rdd, int pnum) {
+    long size = 0;
+    long nummorsels = 1;
+    HashTable *hot = NULL;
+    if (rdd->trans == JOIN && rdd->keyhash) {
+        nummorsels = join_morsels(rdd, pnum, &size, &hot);
+    } else {
+        long units = morsel_units(rdd, pnum, &size);
+        nummorsels = units > 0 ? (size + units - 1) / units : 1;
+    }
+    if (nummorsels <= 1) {
+        if (hot) {
+            free_hashtable(hot);
+        }
+        submit_task(rdd, pnum, PARTITION_TASK);
+        return;
+    }
+
+    Morsels *morsels = (Morsels *)malloc(sizeof(Morsels));
+    morsels->nummorsels = (int)nummorsels;
+    morsels->numdone = 0;
+    morsels->size = size;
+    morsels->out = (Vector **)calloc(nummorsels, sizeof(Vector *));
+    morsels->arenas = (Arena **)calloc(nummorsels, sizeof(Arena *));
+    morsels->hot = hot;
+    morsels->table = NULL;
+    morsels->hashes = NULL;
+    morsels->hotrows = NULL;
+    morsels->numhotrows = 0;
+    pthread_mutex_init(&morsels->buildLock, NULL);
+    for (int i = 0; i < nummorsels; ++i) {
+        Task *task = new_task(rdd, pnum, MORSEL_TASK);
+        task->morsels = morsels;
+        task->morsel = i;
+        thread_pool_submit(task);
+    }
+}
+
+// Whether "rdd" is computed by a map side, one SHUFFLE_MAP_TASK per
+// input partition, and then a gather side, one task per partition.
+static int is_shuffle(RDD *rdd) {
+    return rdd->trans == PARTITIONBY || rdd->trans == AGGREGATEBYKEY ||
+           rdd->trans == SORTBY;
+}
+
+// Number of tasks of "rdd" that read its inputs: one per partition, or
+// for a shuffle one map-side task per input partition. Input task
+// "pnum" reads partition "pnum" of every input.
+static int num_input_tasks(RDD *rdd) {
+    if (is_shuffle(rdd)) {
+        return rdd->dependencies[0]->numpartitions;
+    }
+    return rdd->numpartitions;
+}
+
+// The "k" smallest elements added so far, as a max-heap under "cmp".
+typedef struct {
+    void **heap;
+    long size;
+    long k;
+    Comparator cmp;
+    void *ctx;
+} Smallest;
+
+static void init_smallest(Smallest *s, long k, Comparator cmp, void *ctx) {
+    s->heap = (void **)malloc(sizeof(void *) * (k > 0 ? k : 1));
+    if (s->heap == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    s->size = 0;
+    s->k = k;
+    s->cmp = cmp;
+    s->ctx = ctx;
+}
+
+// Restore the max-heap of the first "size" elements below position "i".
+static void sift_down(Smallest *s, long size, long i) {
+    while (1) {
+        long largest = i;
+        long left = 2 * i + 1;
+        long right = left + 1;
+        if (left < size &&
+            s->cmp(s->heap[left], s->heap[largest], s->ctx) > 0) {
+            largest = left;
+        }
+        if (right < size &&
+            s->cmp(s->heap[right], s->heap[largest], s->ctx) > 0) {
+            largest = right;
+        }
+        if (largest == i) {
+            return;
+        }
+        void *tmp = s->heap[i];
+        s->heap[i] = s->heap[largest];
+        s->heap[largest] = tmp;
+        i = largest;
+    }
+}
+
+static void add_smallest(Smallest *s, void *elem) {
+    if (s->size < s->k) {
+        // sift the new element up
+        long i = s->size++;
+        while (i > 0 && s->cmp(elem, s->heap[(i - 1) / 2], s->ctx) > 0) {
+            s->heap[i] = s->heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        s->heap[i] = elem;
+    } else if (s->k > 0 && s->cmp(elem, s->heap[0], s->ctx) < 0) {
+        s->heap[0] = elem;
+        sift_down(s, s->size, 0);
+    }
+}
+
+// Sort the heap in ascending order, after which nothing may be added.
+static void sort_smallest(Smallest *s) {
+    for (long end = s->size - 1; end > 0; --end) {
+        void *tmp = s->heap[0];
+        s->heap[0] = s->heap[end];
+        s->heap[end] = tmp;
+        sift_down(s, end, 0);
+    }
+}
+
+// Comparator of the SortSamples of SORTBY "arg".
+static int compare_samples(void *a, void *b, void *arg) {
+    RDD *rdd = (RDD *)arg;
+    return ((Comparator)(rdd->fn))(((SortSample *)a)->elem,
+                                   ((SortSample *)b)->elem, rdd->ctx);
+}
+
+// Every input partition of SORTBY "rdd" is sorted: pick the bounds of
+// its output partitions so that each gets about the same weight of
+// samples, like Spark's RangePartitioner. Bounds are distinct, so with
+// many equal elements fewer partitions get any.
+static void pick_bounds(RDD *rdd) {
+    long numsamples = get_size(rdd->samples);
+    Smallest sorted;
+    init_smallest(&sorted, numsamples, compare_samples, rdd);
+    double total = 0;
+    for (long i = 0; i < numsamples; ++i) {
+        SortSample *sample = get_nth_elem(rdd->samples, i);
+        add_smallest(&sorted, sample);
+        total += sample->weight;
+    }
+    sort_smallest(&sorted);
+
+    rdd->bounds = (void **)malloc(sizeof(void *) *
+                                  max(rdd->numpartitions - 1, 1));
+    rdd->numbounds = 0;
+    double step = total / max(rdd->numpartitions, 1);
+    double weight = 0;
+    for (long i = 0;
+         i < numsamples && rdd->numbounds < rdd->numpartitions - 1; ++i) {
+        SortSample *sample = sorted.heap[i];
+        weight += sample->weight;
+        if (weight < step * (rdd->numbounds + 1)) {
+            continue;
+        }
+        if (rdd->numbounds == 0 ||
+            ((Comparator)(rdd->fn))(sample->elem,
+                                    rdd->bounds[rdd->numbounds - 1],
+                                    rdd->ctx) > 0) {
+            rdd->bounds[rdd->numbounds++] = sample->elem;
+        }
+    }
+    free(sorted.heap);
+}
+
+// Free the sorted inputs of SORTBY "rdd", which every gather task read,
+// and its samples and bounds.
+static void free_sort_state(RDD *rdd) {
+    for (int i = 0; i < rdd->dependencies[0]->numpartitions; ++i) {
+        Vector *run = rdd->shuffle[(size_t)i * rdd->numpartitions];
+        if (run != NULL) {
+            free_vector(run);
+            rdd->shuffle[(size_t)i * rdd->numpartitions] = NULL;
+        }
+    }
+    for (long i = 0; i < get_size(rdd->samples); ++i) {
+        free(get_nth_elem(rdd->samples, i));
+    }
+    free_list(rdd->samples);
+    rdd->samples = NULL;
+    free(rdd->bounds);
+    rdd->bounds = NULL;
+    rdd->numbounds = 0;
+}
+
+// Free stored partition "pnum" of "rdd": its list, and for owned
+// elements the elements and their MS_Alloc() memory, which otherwise
+// joins the memory kept with the whole RDD.
+static void free_partition(RDD *rdd, int pnum) {
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    Vector *partition = get_nth_elem(rdd->partitions, pnum);
+    Arena *arena = rdd->arenas[pnum];
+    list_insert_at(rdd->partitions, NULL, pnum);
+    rdd->arenas[pnum] = NULL;
+    if (!rdd->owned && arena && rdd->shared == NULL) {
+        rdd->shared = arena;
+    } else if (!rdd->owned && arena) {
+        arena_merge(rdd->shared, arena);
+    }
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+
+    for (long i = 0; rdd->destroy && i < vector_size(partition); ++i) {
+        rdd->destroy(vector_get(partition, i));
+    }
+    if (rdd->owned) {
+        free_arena(arena);
+    }
+    free_vector(partition);
+}
+
+// "rdd" no longer belongs to a job: wake the actions waiting for it,
+// and plan the jobs that were deferred over it.
+static void release_job(RDD *rdd) {
+    pthread_mutex_lock(&computedLock);
+    rdd->job = NULL;
+    pthread_cond_broadcast(&computedCond);
+    pthread_mutex_unlock(&computedLock);
+    plan_deferred();
+}
+
+// One of the partitions "rdd" held, or its own tasks' hold, is
+// released. Once nothing is held, whatever partitions no task read
+// are freed too, the RDD counts as not computed again, and its job
+// lets other actions plan over it.
+static void drop_hold(RDD *rdd) {
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    int released = --rdd->numheld == 0;
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+    if (!released) {
+        return;
+    }
+
+    for (int i = 0; i < rdd->numpartitions; ++i) {
+        if (get_nth_elem(rdd->partitions, i) != NULL) {
+            free_partition(rdd, i);
+        }
+    }
+    free(rdd->readers);
+    rdd->readers = NULL;
+    if (rdd->owned) {
+        free_arena(rdd->shared);
+        rdd->shared = NULL;
+    }
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    rdd->numComputed = 0;
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+    release_job(rdd);
+}
+
+// A task that read stored partition "pnum" of "rdd" is done. The last
+// of the partition's readers frees it.
+static void release_partition(RDD *rdd, int pnum) {
+    if (rdd->readers == NULL || pnum >= rdd->numpartitions) {
+        return;
+    }
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    int unread = --rdd->readers[pnum] == 0;
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+    if (unread) {
+        free_partition(rdd, pnum);
+        drop_hold(rdd);
+    }
+}
+
+// Every task of "rdd" is done: drop the scheduling state of this action.
+static void finish_rdd(RDD *rdd) {
+    Job *job = rdd->job;
+    if (rdd->trans == SORTBY && rdd->shuffle != NULL) {
+        free_sort_state(rdd);
+    }
+    // every other bucket was consumed by the gather tasks
+    free(rdd->shuffle);
+    rdd->shuffle = NULL;
+    if (rdd->broadcast != NULL) {
+        free_hashtable(rdd->broadcast);
+        rdd->broadcast = NULL;
+    }
+    if (rdd->bloom != NULL) {
+        free_bloom(rdd->bloom);
+        rdd->bloom = NULL;
+    }
+    free(rdd->pendingDeps);
+    rdd->pendingDeps = NULL;
+    free_list(rdd->dependents);
+    rdd->dependents = NULL;
+
+    // an RDD whose partitions are still read keeps its job until they
+    // are released
+    if (rdd->readers != NULL) {
+        drop_hold(rdd);
+        return;
+    }
+    release_job(rdd);
+
+    if (job && job->rdd == rdd && job->finish) {
+        job->finish(job);
+    }
+}
+
+// Wait until every partition of "rdd" is stored. Unlike
+// thread_pool_wait(), this does not wait for the losing runs of
+// speculated tasks, which may still be finishing.
+static void wait_computed(RDD *rdd) {
+    pthread_mutex_lock(&computedLock);
+    while (!is_computed(rdd)) {
+        pthread_cond_wait(&computedCond, &computedLock);
+    }
+    pthread_mutex_unlock(&computedLock);
+}
+
+static void submit_partition_tasks(RDD *rdd) {
+    if (rdd->numpartitions == 0) {
+        finish_rdd(rdd);
+        return;
+    }
+    for (int i = 0; i < rdd->numpartitions; ++i) {
+        submit_task(rdd, i, PARTITION_TASK);
+    }
+}
+
+// One input partition that input task "pnum" of "rdd" reads is stored.
+// Submit the task if it was the last one it waited for.
+static void release_input_task(RDD *rdd, int pnum) {
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    int ready = --rdd->pendingDeps[pnum] == 0;
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+    if (ready && is_shuffle(rdd)) {
+        submit_task(rdd, pnum, SHUFFLE_MAP_TASK);
+    } else if (ready) {
+        submit_partition(rdd, pnum);
+    }
+}
+
+static int list_contains(List *list, void *elem) {
+    for (int i = 0; i < get_size(list); ++i) {
+        if (get_nth_elem(list, i) == elem) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The first RDD below "rdd", itself included, whose stage another job
+// is computing or still releasing, or NULL. Called with computedLock
+// held.
+static RDD *find_busy_rdd(RDD *rdd) {
+    RDD *busy = NULL;
+    List *seen = list_init(LIST_INIT_CAPACITY);
     List *queue = list_init(LIST_INIT_CAPACITY);
-    List *rdd_list = list_init(LIST_INIT_CAPACITY);
 
     list_add_elem(queue, rdd);
-    list_add_elem(rdd_list, rdd);
-    while (get_size(queue) != 0) {
+    while (busy == NULL && get_size(queue) != 0) {
         RDD *curr = list_remove_front(queue);
+        if (list_contains(seen, curr)) {
+            continue;
+        }
+        list_add_elem(seen, curr);
+        // a computed RDD keeps its job while its partitions are released
+        if (curr->job != NULL) {
+            busy = curr;
+        } else if (is_computed(curr)) {
+            continue;
+        }
         for (int i = 0; i < curr->numdependencies; ++i) {
             list_add_elem(queue, curr->dependencies[i]);
-            list_add_elem(rdd_list, curr->dependencies[i]);
         }
     }
+    free_list(queue);
+    free_list(seen);
 
-    List *rev = list_reverse(rdd_list);
-    free_list(rdd_list);
+    return busy;
+}
 
-    return rev;
+// Walk the DAG below "rdd" and return every RDD that still has to be
+// computed. Each of them is registered as a dependent of the uncomputed
+// RDDs it reads from. An allocated `dependents` list marks an RDD as
+// already visited.
+static List *collect_pending_rdds(RDD *rdd) {
+    List *pending = list_init(LIST_INIT_CAPACITY);
+    List *queue = list_init(LIST_INIT_CAPACITY);
+
+    rdd->dependents = list_init(LIST_INIT_CAPACITY);
+    list_add_elem(queue, rdd);
+    while (get_size(queue) != 0) {
+        RDD *curr = list_remove_front(queue);
+        list_add_elem(pending, curr);
+        for (int i = 0; i < curr->numdependencies; ++i) {
+            RDD *dep = curr->dependencies[i];
+            if (is_computed(dep)) {
+                continue;
+            }
+            if (dep->dependents == NULL) {
+                dep->dependents = list_init(LIST_INIT_CAPACITY);
+                list_add_elem(queue, dep);
+            }
+            // a self-join reads the same input once per partition
+            if (!list_contains(dep->dependents, curr)) {
+                list_add_elem(dep->dependents, curr);
+            }
+        }
+    }
+    free_list(queue);
+
+    return pending;
+}
+
+static int is_narrow(RDD *rdd) {
+    return rdd->trans == MAP || rdd->trans == FILTER;
+}
+
+// Whether every task of "rdd" reads the whole of its input "input".
+static int is_broadcast(RDD *rdd, RDD *input) {
+    return (rdd->trans == BROADCASTJOIN || rdd->trans == SEMIJOIN) &&
+           rdd->dependencies[1] == input;
+}
+
+// Whether the tasks of "consumer" can compute "rdd" as part of theirs:
+// a MAP or FILTER, or a SEMIJOIN filtering it.
+static int fuses_into(RDD *rdd, RDD *consumer) {
+    return is_narrow(consumer) ||
+           (consumer->trans == SEMIJOIN && !is_broadcast(consumer, rdd));
+}
+
+// The RDD whose tasks compute "rdd": itself, or the top of the narrow
+// chain it is fused into.
+static RDD *stage_of(RDD *rdd) {
+    while (rdd->fused) {
+        rdd = get_nth_elem(rdd->dependents, 0);
+    }
+    return rdd;
+}
+
+// Estimated run time of one task of "rdd", in usec: the average of its
+// own tasks so far, else of all tasks of the same transformation, else
+// one unit, which makes critical paths fall back to DAG depth.
+static long task_estimate(RDD *rdd) {
+    long estimate = 0;
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    if (rdd->numTimed > 0) {
+        estimate = rdd->taskTime / rdd->numTimed;
+    }
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+    if (estimate == 0) {
+        pthread_mutex_lock(&statsLock);
+        if (transTimed[rdd->trans] > 0) {
+            estimate = transTime[rdd->trans] / transTimed[rdd->trans];
+        }
+        pthread_mutex_unlock(&statsLock);
+    }
+    return estimate > 0 ? estimate : 1;
+}
+
+// Length of the longest chain of tasks from "rdd" to the action's RDD,
+// memoized in `priority` (negative until computed).
+static long critical_path(RDD *rdd) {
+    if (rdd->priority >= 0) {
+        return rdd->priority;
+    }
+    long longest = 0;
+    for (int i = 0; i < get_size(rdd->dependents); ++i) {
+        long path = critical_path(get_nth_elem(rdd->dependents, i));
+        if (path > longest) {
+            longest = path;
+        }
+    }
+    rdd->priority = task_estimate(rdd) + longest;
+    return rdd->priority;
 }
 
-void execute(RDD *rdd) {
-    List *rdds = get_tasks_list(rdd);
-    seek_to_start(rdds);
+static int compare_times(const void *a, const void *b) {
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+int is_straggler(Task *task, long elapsed) {
+    RDD *rdd = task->rdd;
+    if (elapsed < SPECULATION_MIN_USEC) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    int numtimes = rdd->numTimed < TASK_TIME_SAMPLES ? (int)rdd->numTimed
+                                                     : TASK_TIME_SAMPLES;
+    // too early to tell what a normal task of this RDD takes
+    if (numtimes == 0 || 2 * rdd->numComputed < rdd->numpartitions) {
+        pthread_mutex_unlock(&(rdd->partitionListLock));
+        return 0;
+    }
+    long times[TASK_TIME_SAMPLES];
+    memcpy(times, rdd->taskTimes, sizeof(long) * numtimes);
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+
+    qsort(times, numtimes, sizeof(long), compare_times);
+    return elapsed > SPECULATION_MULTIPLIER * times[numtimes / 2];
+}
+
+// The slot of "shape" in shapeTimes, free if it was never timed, or
+// NULL when the table is full. Called with statsLock held.
+static ShapeTime *shape_slot(unsigned long shape) {
+    for (int i = 0; i < SHAPE_SLOTS; ++i) {
+        ShapeTime *slot = &shapeTimes[(shape + i) % SHAPE_SLOTS];
+        if (slot->shape == shape || slot->shape == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Identify the work of a task of stage top "top", its numfused RDDs
+// below it and the kind of input they read, by their transformations
+// and functions. Never 0.
+static unsigned long stage_shape(RDD *top) {
+    unsigned long shape = 14695981039346656037UL;
+    RDD *rdd = top;
+    for (int i = 0; i <= top->numfused; ++i) {
+        shape = (shape ^ (unsigned long)rdd->trans) * 1099511628211UL;
+        shape = (shape ^ (unsigned long)rdd->fn) * 1099511628211UL;
+        rdd = rdd->dependencies[0];
+    }
+    if (rdd) {
+        shape = (shape ^ (unsigned long)rdd->trans) * 1099511628211UL;
+    }
+    return shape ? shape : 1;
+}
+
+void record_task_time(Task *task) {
+    RDD *rdd = task->rdd;
+    long duration = (long)task->metric->duration;
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    // reservoir sampling: every run so far is kept with equal odds
+    if (rdd->numTimed < TASK_TIME_SAMPLES) {
+        rdd->taskTimes[rdd->numTimed] = duration;
+    } else {
+        long slot = rand_r(&rdd->timeSeed) % (rdd->numTimed + 1);
+        if (slot < TASK_TIME_SAMPLES) {
+            rdd->taskTimes[slot] = duration;
+        }
+    }
+    ++rdd->numTimed;
+    rdd->taskTime += duration;
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+
+    pthread_mutex_lock(&statsLock);
+    transTime[rdd->trans] += duration;
+    ++transTimed[rdd->trans];
+    ShapeTime *slot = shape_slot(rdd->shape);
+    if (slot) {
+        slot->shape = rdd->shape;
+        slot->time += duration;
+        ++slot->timed;
+    }
+    pthread_mutex_unlock(&statsLock);
+}
+
+// Collapse chains of narrow RDDs into one stage per chain. A MAP or
+// FILTER whose only consumer is another MAP or FILTER is fused into it:
+// its elements flow through the consumer's task and are never stored.
+// Only the stage tops stay in "pending"; their dependents now point at
+// stage tops too. Each input task of a stage top counts the input
+// partitions it waits for, plus one held by execute() until the whole
+// DAG is planned, and gets the critical path of its stage as priority.
+// Stage tops remember how many RDDs are fused below them, and which job
+// computes them until they are stored.
+static void plan_stages(List *pending, RDD *target, Job *job) {
     RDD *rdd_ptr = NULL;
-    while ((rdd_ptr = next(rdds)) != NULL) {
-        for (int i = 0; i < rdd_ptr->numpartitions; ++i) {
-            Task *task = (Task *)malloc(sizeof(Task));
-            TaskMetric *metric = (TaskMetric *)malloc(sizeof(TaskMetric));
-            task->rdd = rdd_ptr;
-            task->pnum = i;
-            task->metric = metric;
-            metric->pnum = i;
-            metric->rdd = rdd_ptr;
-            clock_gettime(CLOCK_MONOTONIC, &metric->created);
-            thread_pool_submit(task);
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        rdd_ptr->priority = -1;
+        rdd_ptr->fused =
+            rdd_ptr != target && is_narrow(rdd_ptr) &&
+            get_size(rdd_ptr->dependents) == 1 &&
+            fuses_into(rdd_ptr, get_nth_elem(rdd_ptr->dependents, 0));
+    }
+
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        if (rdd_ptr->fused) {
+            continue;
+        }
+        rdd_ptr->job = job;
+        rdd_ptr->numfused = 0;
+        for (RDD *r = rdd_ptr;
+             (is_narrow(r) || r->trans == SEMIJOIN) &&
+             r->dependencies[0]->fused;
+             r = r->dependencies[0]) {
+            ++rdd_ptr->numfused;
+        }
+        rdd_ptr->shape = stage_shape(rdd_ptr);
+        int numtasks = num_input_tasks(rdd_ptr);
+        rdd_ptr->pendingDeps = (int *)malloc(sizeof(int) * max(numtasks, 1));
+        for (int i = 0; i < numtasks; ++i) {
+            rdd_ptr->pendingDeps[i] = 1;
+        }
+    }
+
+    // Narrow and co-partitioned dependencies are tracked per partition:
+    // input task p only waits for partition p of the RDDs it reads. The
+    // whole-RDD barriers, between the map and gather sides of a shuffle
+    // and before the tasks probing a broadcast input, are kept by
+    // task_done().
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        if (rdd_ptr->fused) {
+            continue;
+        }
+        for (int i = 0; i < get_size(rdd_ptr->dependents); ++i) {
+            RDD *top = stage_of(get_nth_elem(rdd_ptr->dependents, i));
+            list_insert_at(rdd_ptr->dependents, top, i);
+            int numtasks = num_input_tasks(top);
+            if (is_broadcast(top, rdd_ptr)) {
+                // an empty input is never stored, so never waited for
+                for (int p = 0; p < numtasks && rdd_ptr->numpartitions > 0;
+                     ++p) {
+                    ++top->pendingDeps[p];
+                }
+                continue;
+            }
+            for (int p = 0; p < numtasks && p < rdd_ptr->numpartitions; ++p) {
+                ++top->pendingDeps[p];
+            }
+        }
+    }
+
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        if (!rdd_ptr->fused) {
+            critical_path(rdd_ptr);
+        }
+    }
+
+    // keep only the stage tops, fused RDDs no longer need consumers
+    int numpending = get_size(pending);
+    for (int i = 0; i < numpending; ++i) {
+        rdd_ptr = list_remove_front(pending);
+        rdd_ptr->numComputed = 0;
+        if (rdd_ptr->fused) {
+            free_list(rdd_ptr->dependents);
+            rdd_ptr->dependents = NULL;
+        } else {
+            list_add_elem(pending, rdd_ptr);
+        }
+    }
+}
+
+// The RDDs whose stored partitions the tasks of stage top "top" read,
+// in "inputs". Returns how many there are.
+static int stage_inputs(RDD *top, RDD **inputs) {
+    if (top->trans == JOIN || top->trans == BROADCASTJOIN) {
+        inputs[0] = top->dependencies[0];
+        inputs[1] = top->dependencies[1];
+        return 2;
+    }
+    RDD *source = top->dependencies[0];
+    for (int i = 0; i < top->numfused; ++i) {
+        source = source->dependencies[0];
+    }
+    inputs[0] = source;
+    if (top->trans == SEMIJOIN) {
+        inputs[1] = top->dependencies[1];
+        return 2;
+    }
+    return 1;
+}
+
+// Whether the tasks of stage top "top" read the whole of its stage
+// input "slot", rather than one partition each.
+static int reads_whole(RDD *top, int slot) {
+    return slot == 1 &&
+           (top->trans == BROADCASTJOIN || top->trans == SEMIJOIN);
+}
+
+// Count the readers of each partition of the stage tops "pending" but
+// "target": one per task reading it, or per task of a stage that reads
+// the whole RDD. An RDD read by a speculated stage is not counted, and
+// stays stored: the losing run of a task may still be reading it after
+// the winner is done.
+static void count_readers(List *pending, RDD *target) {
+    RDD *rdd_ptr = NULL;
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        if (rdd_ptr != target) {
+            rdd_ptr->readers =
+                (int *)calloc(max(rdd_ptr->numpartitions, 1), sizeof(int));
+        }
+    }
+
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        RDD *inputs[MAXDEPS];
+        int numinputs = stage_inputs(rdd_ptr, inputs);
+        int numtasks = num_input_tasks(rdd_ptr);
+        for (int i = 0; i < numinputs; ++i) {
+            RDD *input = inputs[i];
+            if (input->readers != NULL && stage_is_idempotent(rdd_ptr)) {
+                free(input->readers);
+                input->readers = NULL;
+            }
+            for (int p = 0; input->readers && p < input->numpartitions;
+                 ++p) {
+                if (reads_whole(rdd_ptr, i)) {
+                    input->readers[p] += numtasks > 0;
+                } else if (p < numtasks) {
+                    ++input->readers[p];
+                }
+            }
+        }
+    }
+
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        rdd_ptr->numheld = 1;
+        for (int p = 0; rdd_ptr->readers && p < rdd_ptr->numpartitions; ++p) {
+            rdd_ptr->numheld += rdd_ptr->readers[p] > 0;
+        }
+    }
+}
+
+// Task "pnum" of stage top "top" is done reading its input partitions.
+static void release_inputs(RDD *top, int pnum) {
+    RDD *inputs[MAXDEPS];
+    int numinputs = stage_inputs(top, inputs);
+    for (int i = 0; i < numinputs; ++i) {
+        if (!reads_whole(top, i)) {
+            release_partition(inputs[i], pnum);
+        }
+    }
+}
+
+// Every task of stage top "top" is done, and so with the inputs it reads
+// whole.
+static void release_whole_inputs(RDD *top) {
+    RDD *inputs[MAXDEPS];
+    int numinputs = stage_inputs(top, inputs);
+    for (int i = 0; i < numinputs && num_input_tasks(top) > 0; ++i) {
+        for (int p = 0; reads_whole(top, i) && p < inputs[i]->numpartitions;
+             ++p) {
+            release_partition(inputs[i], p);
         }
     }
 }
 
+// Whether the stage tops "pending" are cheap enough that handing them
+// to the workers would cost more than computing them right here: a few
+// tasks over tiny inputs, all of them timed by earlier runs and cheap.
+// A stage that never ran may call an expensive function, so it always
+// goes to the workers. Only the inputs stored before this plan are
+// measured. Other jobs may still be finishing those, so only the stage
+// tops in "pending" are ours to read.
+static int is_tiny(List *pending) {
+    long numtasks = 0;
+    long bytes = 0;
+    long elems = 0;
+    long usec = 0;
+    RDD *rdd_ptr = NULL;
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        int tasks = num_input_tasks(rdd_ptr);
+        if (is_shuffle(rdd_ptr)) {
+            tasks += rdd_ptr->numpartitions;
+        }
+        numtasks += tasks;
+        pthread_mutex_lock(&(rdd_ptr->partitionListLock));
+        long time = rdd_ptr->taskTime;
+        long numtimed = rdd_ptr->numTimed;
+        pthread_mutex_unlock(&(rdd_ptr->partitionListLock));
+        if (numtimed == 0) {
+            // a new RDD, maybe of a stage shape that ran before
+            pthread_mutex_lock(&statsLock);
+            ShapeTime *slot = shape_slot(rdd_ptr->shape);
+            if (slot && slot->shape == rdd_ptr->shape) {
+                time = slot->time;
+                numtimed = slot->timed;
+            }
+            pthread_mutex_unlock(&statsLock);
+        }
+        if (numtimed == 0) {
+            return 0;
+        }
+        usec += tasks * (time / numtimed);
+    }
+    if (numtasks > INLINE_MAX_TASKS || usec > INLINE_MAX_USEC) {
+        return 0;
+    }
+
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        RDD *inputs[MAXDEPS];
+        int numinputs = stage_inputs(rdd_ptr, inputs);
+        for (int i = 0; i < numinputs; ++i) {
+            RDD *input = inputs[i];
+            if (list_contains(pending, input)) {
+                continue;  // computed by this plan
+            }
+            for (int p = 0; p < input->numpartitions; ++p) {
+                void *partition = get_nth_elem(input->partitions, p);
+                struct stat st;
+                if (input->trans != FILE_BACKED) {
+                    elems += vector_size((Vector *)partition);
+                } else if (fstat(fileno((FILE *)partition), &st) == 0) {
+                    bytes += st.st_size;
+                } else {
+                    return 0;
+                }
+            }
+        }
+    }
+    return bytes <= INLINE_MAX_BYTES && elems <= INLINE_MAX_ELEMS;
+}
+
+static void run_inline(RDD *rdd, int pnum, TaskKind kind) {
+    Task task;
+    TaskMetric metric;
+    init_task(&task, &metric, rdd, pnum, kind);
+    task.speculative = 0;
+    thread_pool_run_inline(&task);
+}
+
+// Compute stage top "top" of "pending" and the stage tops it reads on
+// the calling thread, inputs first. Stage tops of the plan that are
+// done have their pendingDeps freed by finish_rdd().
+static void execute_inline(RDD *top, List *pending) {
+    RDD *inputs[MAXDEPS];
+    int numinputs = stage_inputs(top, inputs);
+    for (int i = 0; i < numinputs; ++i) {
+        if (list_contains(pending, inputs[i]) &&
+            inputs[i]->pendingDeps != NULL) {
+            execute_inline(inputs[i], pending);
+        }
+    }
+
+    if (is_shuffle(top)) {
+        for (int i = 0; i < num_input_tasks(top); ++i) {
+            run_inline(top, i, SHUFFLE_MAP_TASK);
+        }
+        if (top->trans == SORTBY) {
+            pick_bounds(top);
+        }
+    }
+    for (int i = 0; i < top->numpartitions; ++i) {
+        run_inline(top, i, PARTITION_TASK);
+    }
+    for (int i = 0; i < num_input_tasks(top); ++i) {
+        release_inputs(top, i);
+    }
+    release_whole_inputs(top);
+    pthread_mutex_lock(&(top->partitionListLock));
+    top->numComputed = top->numpartitions;
+    pthread_mutex_unlock(&(top->partitionListLock));
+    finish_rdd(top);
+}
+
+// Plan "job", with computedLock held and no stage of its DAG busy in
+// another job, and release the lock. Only the thread that submitted
+// the job may compute it inline, since it waits for it anyway.
+static void plan_job(Job *job, int mayinline) {
+    RDD *rdd = job->rdd;
+    if (is_computed(rdd)) {
+        // the job may be freed by its waiter as soon as we unlock
+        void (*finish)(Job *) = job->finish;
+        pthread_mutex_unlock(&computedLock);
+        if (finish) {
+            finish(job);
+        }
+        return;
+    }
+
+    List *pending = collect_pending_rdds(rdd);
+    plan_stages(pending, rdd, job);
+    count_readers(pending, rdd);
+    RDD *rdd_ptr = NULL;
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        if (rdd_ptr->partitions == NULL) {
+            rdd_ptr->partitions = list_init(max(rdd_ptr->numpartitions, 1));
+            rdd_ptr->arenas = (Arena **)calloc(
+                max(rdd_ptr->numpartitions, 1), sizeof(Arena *));
+        }
+        if (is_shuffle(rdd_ptr)) {
+            RDD *dep = rdd_ptr->dependencies[0];
+            rdd_ptr->numShuffled = 0;
+            rdd_ptr->shuffle = (Vector **)calloc(
+                (size_t)max(dep->numpartitions, 1) *
+                    max(rdd_ptr->numpartitions, 1),
+                sizeof(Vector *));
+        }
+        if (rdd_ptr->trans == SORTBY) {
+            rdd_ptr->samples = list_init(LIST_INIT_CAPACITY);
+        }
+    }
+    // every stage is marked as ours, so other jobs stay out of it
+    pthread_mutex_unlock(&computedLock);
+
+    if (mayinline && is_tiny(pending)) {
+        execute_inline(rdd, pending);
+        free_list(pending);
+        return;
+    }
+    thread_pool_add_job(job);
+
+    // Workers release input tasks as soon as the first task is
+    // submitted, so every counter is planned before dropping our hold.
+    seek_to_start(pending);
+    while ((rdd_ptr = next(pending)) != NULL) {
+        int numtasks = num_input_tasks(rdd_ptr);
+        if (numtasks == 0) {
+            // a shuffle of an empty RDD still has outputs to store
+            submit_partition_tasks(rdd_ptr);
+        }
+        for (int i = 0; i < numtasks; ++i) {
+            release_input_task(rdd_ptr, i);
+        }
+    }
+    free_list(pending);
+}
+
+// Plan the deferred jobs whose DAG no other job is computing anymore,
+// oldest first.
+static void plan_deferred(void) {
+    while (1) {
+        pthread_mutex_lock(&computedLock);
+        Job **link = &deferredJobs;
+        while (*link != NULL && find_busy_rdd((*link)->rdd) != NULL) {
+            link = &(*link)->deferred;
+        }
+        Job *job = *link;
+        if (job == NULL) {
+            pthread_mutex_unlock(&computedLock);
+            return;
+        }
+        *link = job->deferred;
+        job->deferred = NULL;
+        plan_job(job, 0);
+    }
+}
+
+void execute(RDD *rdd, Job *job) {
+    // Jobs are planned one at a time, and never over a stage another
+    // job is still computing: its scheduling state is in use, and its
+    // partitions will be there to reuse once it is stored. Such a job
+    // is deferred rather than waited for, so submitting never blocks;
+    // release_job() plans it once that stage is done.
+    pthread_mutex_lock(&computedLock);
+    job->deferred = NULL;
+    if (find_busy_rdd(rdd) != NULL) {
+        Job **link = &deferredJobs;
+        while (*link != NULL) {
+            link = &(*link)->deferred;
+        }
+        *link = job;
+        pthread_mutex_unlock(&computedLock);
+        return;
+    }
+    plan_job(job, 1);
+}
+
+// The partitions of the RDD computed so far by one take(), in order.
+// For takeOrdered(), only the "n" smallest elements of each partition.
+typedef struct Take {
+    long n;
+    Comparator cmp;     // takeOrdered() only, else NULL
+    void *ctx;          // for cmp
+    Vector **out;       // per partition, NULL until computed
+    int prefix;         // partitions [0, prefix) are all in out
+    long found;         // elements in those partitions
+    int running;        // tasks of the current batch not done yet
+    atomic_int cancel;  // n elements were found: stop the running tasks
+    pthread_mutex_t lock;
+    pthread_cond_t batchDone;
+} Take;
+
+// Cut "out" down to its "take->n" smallest elements, in order.
+static void keep_smallest(Take *take, Vector *out) {
+    Smallest smallest;
+    init_smallest(&smallest, take->n, take->cmp, take->ctx);
+    for (long i = 0; i < vector_size(out); ++i) {
+        add_smallest(&smallest, vector_get(out, i));
+    }
+    sort_smallest(&smallest);
+    vector_clear(out);
+    for (long i = 0; i < smallest.size; ++i) {
+        vector_append(out, smallest.heap[i]);
+    }
+    free(smallest.heap);
+}
+
+void take_trim(Task *task, Vector *out) {
+    Take *take = task->take;
+    // cutting at twice n keeps the cost per element O(log n)
+    if (take->cmp && vector_size(out) / 2 >= take->n) {
+        keep_smallest(take, out);
+    }
+}
+
+static void take_task_done(Task *task) {
+    Take *take = task->take;
+    if (take->cmp) {
+        // still on the worker, so every partition is cut down in parallel
+        keep_smallest(take, task->output);
+    }
+    pthread_mutex_lock(&take->lock);
+    take->out[task->pnum] = task->output;
+    while (take->prefix < task->rdd->numpartitions &&
+           take->out[take->prefix] != NULL) {
+        take->found += vector_size(take->out[take->prefix++]);
+    }
+    // later partitions can no longer be among the first n elements
+    if (take->found >= take->n && take->cmp == NULL) {
+        atomic_store(&take->cancel, 1);
+    }
+    if (--take->running == 0) {
+        pthread_cond_signal(&take->batchDone);
+    }
+    pthread_mutex_unlock(&take->lock);
+}
+
+void task_done(Task *task) {
+    RDD *rdd = task->rdd;
+
+    if (task->kind == TAKE_TASK) {
+        take_task_done(task);
+        return;
+    }
+
+    // the gather side of a shuffle reads its buckets instead
+    if (task->kind == SHUFFLE_MAP_TASK || !is_shuffle(rdd)) {
+        release_inputs(rdd, task->pnum);
+    }
+
+    if (task->kind == SHUFFLE_MAP_TASK) {
+        pthread_mutex_lock(&(rdd->partitionListLock));
+        int shuffled =
+            ++rdd->numShuffled == rdd->dependencies[0]->numpartitions;
+        pthread_mutex_unlock(&(rdd->partitionListLock));
+        if (shuffled && rdd->trans == SORTBY) {
+            pick_bounds(rdd);
+        }
+        if (shuffled) {
+            submit_partition_tasks(rdd);
+        }
+        return;
+    }
+
+    // partition pnum is stored, whatever else of this RDD is still running
+    for (int i = 0; i < get_size(rdd->dependents); ++i) {
+        RDD *dependent = get_nth_elem(rdd->dependents, i);
+        if (task->pnum < num_input_tasks(dependent) &&
+            !is_broadcast(dependent, rdd)) {
+            release_input_task(dependent, task->pnum);
+        }
+    }
+
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    int computed = ++rdd->numComputed == rdd->numpartitions;
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+    if (!computed) {
+        return;
+    }
+    // and so is the whole RDD, for the joins that broadcast it
+    for (int i = 0; i < get_size(rdd->dependents); ++i) {
+        RDD *dependent = get_nth_elem(rdd->dependents, i);
+        for (int p = 0;
+             is_broadcast(dependent, rdd) && p < num_input_tasks(dependent);
+             ++p) {
+            release_input_task(dependent, p);
+        }
+    }
+    release_whole_inputs(rdd);
+    finish_rdd(rdd);
+}
+
 void *metric_thread_func(void *arg) {
     FILE *fp = (FILE *)arg;
     while (1) {
@@ -177,11 +1523,10 @@ void *metric_thread_func(void *arg) {
         pthread_mutex_unlock(&metric_queue->queue_lock);
         if (metric->rdd == NULL) {
             fclose(fp);
-            // free(metric);
             break;
         } else {
             print_formatted_metric(metric, fp);
-            // free(metric);
+            thread_pool_release_task(metric->task);
         }
     }
     return NULL;
@@ -207,84 +1552,457 @@ void MS_Run() {
     }
 }
 
+static void free_RDD_resource(RDD *rdd) {
+    for (int i = 0; rdd->partitions && i < rdd->numpartitions; ++i) {
+        if (rdd->trans == FILE_BACKED) {
+            fclose((FILE *)get_nth_elem(rdd->partitions, i));
+            continue;
+        }
+        Vector *partition = (Vector *)get_nth_elem(rdd->partitions, i);
+        for (long j = 0;
+             partition && rdd->destroy && j < vector_size(partition); ++j) {
+            rdd->destroy(vector_get(partition, j));
+        }
+        free_vector(partition);
+        if (rdd->arenas) {
+            free_arena(rdd->arenas[i]);
+        }
+    }
+    free_list(rdd->partitions);
+    free(rdd->arenas);
+    free_arena(rdd->shared);
+}
+
+static void free_All_RDD() {
+    RDD *rdd = NULL;
+    while ((rdd = list_remove_front(allRDDs)) != NULL) {
+        free_RDD_resource(rdd);
+        if (rdd->filenames) {
+            for (int i = 0; i < rdd->numpartitions; ++i) {
+                free(rdd->filenames[i]);
+            }
+            free(rdd->filenames);
+        }
+        pthread_mutex_destroy(&(rdd->partitionListLock));
+        pthread_mutex_destroy(&(rdd->buildLock));
+        free(rdd);
+    }
+    free_list(allRDDs);
+    allRDDs = NULL;
+}
+
+void begin_task_arena() {
+    inTask = 1;
+    taskArena = NULL;
+}
+
+Arena *end_task_arena() {
+    Arena *arena = taskArena;
+    inTask = 0;
+    taskArena = NULL;
+    return arena;
+}
+
+void *MS_Alloc(size_t size) {
+    if (inTask) {
+        if (taskArena == NULL) {
+            taskArena = arena_init();
+        }
+        return arena_alloc(taskArena, size);
+    }
+    pthread_mutex_lock(&sessionArenaLock);
+    if (sessionArena == NULL) {
+        sessionArena = arena_init();
+    }
+    void *ptr = arena_alloc(sessionArena, size);
+    pthread_mutex_unlock(&sessionArenaLock);
+    return ptr;
+}
+
 void MS_TearDown() {
-    thread_pool_destroy();
-    TaskMetric *metric = (TaskMetric *)malloc(sizeof(TaskMetric));
-    metric->rdd = NULL;
+    // Once every task has finished, the metric thread holds the last
+    // references to them; it drops those before the pool frees them.
+    thread_pool_wait();
+    TaskMetric sentinel = {.rdd = NULL};
     pthread_mutex_lock(&metric_queue->queue_lock);
     while (metric_queue->queue->size == METRIC_QUEUE_CAPACITY) {
         pthread_cond_wait(&metric_queue->queue_not_full,
                           &metric_queue->queue_lock);
     }
-    list_add_elem(metric_queue->queue, metric);
+    list_add_elem(metric_queue->queue, &sentinel);
     pthread_cond_signal(&metric_queue->queue_not_empty);
     pthread_mutex_unlock(&metric_queue->queue_lock);
     pthread_join(metric_thread, NULL);
-    // free_list(metric_list);
+    thread_pool_destroy();
+    free_list(metric_queue->queue);
+    pthread_mutex_destroy(&metric_queue->queue_lock);
+    pthread_cond_destroy(&metric_queue->queue_not_empty);
+    pthread_cond_destroy(&metric_queue->queue_not_full);
+    free(metric_queue);
+
+    // the metric thread was the last to read the RDDs
+    if (allRDDs) {
+        free_All_RDD();
+    }
+    free_arena(sessionArena);
+    sessionArena = NULL;
 }
 
-static void free_RDD_resource(RDD *rdd) {
-    List *curr = NULL;
-    seek_to_start(rdd->partitions);
-    while ((curr = (List *)next(rdd->partitions)) != NULL) {
-        void *item = NULL;
-        seek_to_start(curr);
-        while ((item = next(curr)) != NULL) {
-            // free(item);
+static Job *submit_job(RDD *rdd, int weight, void (*finish)(Job *),
+                       void *arg) {
+    Job *job = (Job *)malloc(sizeof(Job));
+    if (job == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    job->rdd = rdd;
+    job->weight = max(weight, 1);
+    job->finish = finish;
+    job->arg = arg;
+    thread_pool_init_job(job);
+    execute(rdd, job);
+    return job;
+}
+
+Job *MS_JobSubmit(RDD *rdd, int weight) {
+    return submit_job(rdd, weight, NULL, NULL);
+}
+
+void MS_JobWait(Job *job) {
+    wait_computed(job->rdd);
+    // another job computed the RDD before this one was planned
+    pthread_mutex_lock(&computedLock);
+    for (Job **link = &deferredJobs; *link != NULL;
+         link = &(*link)->deferred) {
+        if (*link == job) {
+            *link = job->deferred;
+            break;
         }
-        free_list(curr);
     }
-    free_list(rdd->partitions);
+    pthread_mutex_unlock(&computedLock);
+    thread_pool_remove_job(job);
 }
 
-static void free_All_RDD(RDD *rdd) {
-    List *rdds = get_tasks_list(rdd);
-    seek_to_start(rdds);
-    RDD *rdd_ptr = NULL;
-    while ((rdd_ptr = next(rdds)) != NULL) {
-        if (rdd_ptr->numdependencies != 0) {
-            free_RDD_resource(rdd_ptr);
+// Stored partitions may be read by other actions at the same time, so
+// index them instead of moving their shared iterators.
+static long count_partitions(RDD *rdd) {
+    long count = 0;
+    for (int i = 0; i < rdd->numpartitions; ++i) {
+        count += vector_size(get_nth_elem(rdd->partitions, i));
+    }
+    return count;
+}
+
+static void print_partitions(RDD *rdd, Printer p) {
+    // print all the items in rdd
+    // aka... `p(item)` for all items in rdd
+    for (int i = 0; i < rdd->numpartitions; ++i) {
+        Vector *curr = (Vector *)get_nth_elem(rdd->partitions, i);
+        for (long j = 0; j < vector_size(curr); ++j) {
+            p(vector_get(curr, j));
         }
-        free(rdd_ptr);
     }
-    free_list(rdds);
 }
 
-int count(RDD *rdd) {
-    execute(rdd);
-    thread_pool_wait();
+long count(RDD *rdd) {
+    MS_JobWait(MS_JobSubmit(rdd, 1));
+    return count_partitions(rdd);
+}
 
-    int count = 0;
-    List *curr = NULL;
-    seek_to_start(rdd->partitions);
-    while ((curr = (List *)next(rdd->partitions)) != NULL) {
-        count += curr->size;
+void print(RDD *rdd, Printer p) {
+    MS_JobWait(MS_JobSubmit(rdd, 1));
+    print_partitions(rdd, p);
+}
+
+// Copy up to "n" elements of the stored partitions of "rdd", in order.
+static long copy_first(RDD *rdd, long n, void **out) {
+    long numtaken = 0;
+    for (int i = 0; i < rdd->numpartitions && numtaken < n; ++i) {
+        Vector *curr = (Vector *)get_nth_elem(rdd->partitions, i);
+        for (long j = 0; j < vector_size(curr) && numtaken < n; ++j) {
+            out[numtaken++] = vector_get(curr, j);
+        }
     }
+    return numtaken;
+}
 
-    // free_All_RDD(rdd);
+// Copy the "n" smallest elements under "cmp" of the stored partitions of
+// "rdd", in order.
+static long copy_smallest(RDD *rdd, long n, Comparator cmp, void *ctx,
+                          void **out) {
+    Smallest smallest;
+    init_smallest(&smallest, n, cmp, ctx);
+    for (int i = 0; i < rdd->numpartitions; ++i) {
+        Vector *curr = (Vector *)get_nth_elem(rdd->partitions, i);
+        for (long j = 0; j < vector_size(curr); ++j) {
+            add_smallest(&smallest, vector_get(curr, j));
+        }
+    }
+    sort_smallest(&smallest);
+    long numtaken = smallest.size;
+    for (long i = 0; i < numtaken; ++i) {
+        out[i] = smallest.heap[i];
+    }
+    free(smallest.heap);
+    return numtaken;
+}
 
-    return count;
+// The RDD that the chain of uncomputed MAP and FILTER RDDs topped by
+// "rdd" reads, and in "*numfused" how many of the chain are below "rdd".
+static RDD *narrow_source(RDD *rdd, int *numfused) {
+    RDD *source = rdd->dependencies[0];
+    *numfused = 0;
+    while (is_narrow(source) && !is_computed(source)) {
+        source = source->dependencies[0];
+        ++*numfused;
+    }
+    return source;
 }
 
-void print(RDD *rdd, Printer p) {
-    // fprintf(stderr, "from minispark.c@240: %p\n",
-    // get_nth_elem(rdd->dependencies[0]->partitions, 0));
-    execute(rdd);
-    // fprintf(stderr, "from minispark.c@242: %p\n",
-    // get_nth_elem(rdd->dependencies[0]->partitions, 0));
-    thread_pool_wait();
+// Compute partitions [lo, hi) of "rdd" for "take" and wait for them.
+static void run_take_batch(RDD *rdd, Take *take, int lo, int hi) {
+    take->running = hi - lo;
+    for (int i = lo; i < hi; ++i) {
+        Task *task = new_task(rdd, i, TAKE_TASK);
+        task->speculative = 0;
+        task->cancel = &take->cancel;
+        task->take = take;
+        thread_pool_submit(task);
+    }
+    pthread_mutex_lock(&take->lock);
+    while (take->running > 0) {
+        pthread_cond_wait(&take->batchDone, &take->lock);
+    }
+    pthread_mutex_unlock(&take->lock);
+}
 
-    // print all the items in rdd
-    // aka... `p(item)` for all items in rdd
-    List *curr = NULL;
-    seek_to_start(rdd->partitions);
-    while ((curr = (List *)next(rdd->partitions)) != NULL) {
-        void *item = NULL;
-        seek_to_start(curr);
-        while ((item = next(curr)) != NULL) {
-            p(item);
+// take(), or takeOrdered() when "cmp" is set. Then every partition is
+// computed at once and none of them is cancelled.
+static long take_elems(RDD *rdd, long n, Comparator cmp, void *ctx,
+                       void **out) {
+    if (n <= 0) {
+        return 0;
+    }
+    if (!is_narrow(rdd)) {
+        MS_JobWait(MS_JobSubmit(rdd, 1));
+        return cmp ? copy_smallest(rdd, n, cmp, ctx, out)
+                   : copy_first(rdd, n, out);
+    }
+
+    // Claim the final narrow stage like execute() claims a stage top,
+    // once whatever it reads is stored.
+    int numfused = 0;
+    pthread_mutex_lock(&computedLock);
+    while (1) {
+        while (find_busy_rdd(rdd) != NULL) {
+            pthread_cond_wait(&computedCond, &computedLock);
         }
+        if (is_computed(rdd)) {
+            pthread_mutex_unlock(&computedLock);
+            return cmp ? copy_smallest(rdd, n, cmp, ctx, out)
+                       : copy_first(rdd, n, out);
+        }
+        RDD *source = narrow_source(rdd, &numfused);
+        if (is_computed(source)) {
+            break;
+        }
+        pthread_mutex_unlock(&computedLock);
+        MS_JobWait(MS_JobSubmit(source, 1));
+        pthread_mutex_lock(&computedLock);
+    }
+    Job *job = (Job *)malloc(sizeof(Job));
+    if (job == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    job->rdd = rdd;
+    job->weight = 1;
+    job->finish = NULL;
+    job->arg = NULL;
+    thread_pool_init_job(job);
+    rdd->job = job;
+    rdd->numfused = numfused;
+    rdd->shape = stage_shape(rdd);
+    pthread_mutex_unlock(&computedLock);
+    thread_pool_add_job(job);
+
+    Take take;
+    take.n = n;
+    take.cmp = cmp;
+    take.ctx = ctx;
+    take.out = (Vector **)calloc(max(rdd->numpartitions, 1), sizeof(Vector *));
+    take.prefix = 0;
+    take.found = 0;
+    take.running = 0;
+    atomic_init(&take.cancel, 0);
+    pthread_mutex_init(&take.lock, NULL);
+    pthread_cond_init(&take.batchDone, NULL);
+
+    // Like Spark: try one partition, then estimate how many more are
+    // needed from what was found so far, growing by TAKE_SCALE_UP at most.
+    int scanned = 0;
+    long batch = cmp ? rdd->numpartitions : 1;
+    while (take.found < n && scanned < rdd->numpartitions) {
+        int end = (int)(batch < rdd->numpartitions - scanned
+                            ? scanned + batch
+                            : rdd->numpartitions);
+        run_take_batch(rdd, &take, scanned, end);
+        scanned = end;
+        long most = (long)scanned * TAKE_SCALE_UP;
+        if (take.found == 0) {
+            batch = most;
+        } else {
+            batch = (long)(1.5 * n * scanned / take.found) - scanned;
+            batch = batch < 1 ? 1 : batch > most ? most : batch;
+        }
+    }
+
+    long numtaken = 0;
+    if (cmp) {
+        // merge the smallest elements of every partition
+        Smallest smallest;
+        init_smallest(&smallest, n, cmp, ctx);
+        for (int i = 0; i < scanned; ++i) {
+            for (long j = 0; j < vector_size(take.out[i]); ++j) {
+                add_smallest(&smallest, vector_get(take.out[i], j));
+            }
+        }
+        sort_smallest(&smallest);
+        for (; numtaken < smallest.size; ++numtaken) {
+            out[numtaken] = smallest.heap[numtaken];
+        }
+        free(smallest.heap);
+    } else {
+        for (int i = 0; i < take.prefix && numtaken < n; ++i) {
+            Vector *part = take.out[i];
+            for (long j = 0; j < vector_size(part) && numtaken < n; ++j) {
+                out[numtaken++] = vector_get(part, j);
+            }
+        }
+    }
+    for (int i = 0; i < scanned; ++i) {
+        free_vector(take.out[i]);
+    }
+    free(take.out);
+    pthread_mutex_destroy(&take.lock);
+    pthread_cond_destroy(&take.batchDone);
+
+    release_job(rdd);
+    thread_pool_remove_job(job);
+    return numtaken;
+}
+
+long take(RDD *rdd, long n, void **out) {
+    return take_elems(rdd, n, NULL, NULL, out);
+}
+
+long takeOrdered(RDD *rdd, long k, Comparator fn, void *ctx, void **out) {
+    return take_elems(rdd, k, fn, ctx, out);
+}
+
+void *first(RDD *rdd) {
+    void *elem = NULL;
+    take(rdd, 1, &elem);
+    return elem;
+}
+
+struct Future {
+    Job *job;
+    Printer printer;  // print_async() only
+    long result;
+    int done;       // the result is set
+    int settled;    // and the callback, if any, has returned
+    Callback callback;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t settledCond;
+};
+
+// Job::finish of asynchronous actions, run once the RDD is computed.
+static void complete_future(Job *job) {
+    Future *future = (Future *)job->arg;
+    long result = 0;
+    if (future->printer) {
+        print_partitions(job->rdd, future->printer);
+    } else {
+        result = count_partitions(job->rdd);
+    }
+
+    pthread_mutex_lock(&future->lock);
+    future->result = result;
+    future->done = 1;
+    Callback callback = future->callback;
+    void *arg = future->arg;
+    pthread_mutex_unlock(&future->lock);
+
+    if (callback) {
+        callback(result, arg);
+    }
+    pthread_mutex_lock(&future->lock);
+    future->settled = 1;
+    pthread_cond_broadcast(&future->settledCond);
+    pthread_mutex_unlock(&future->lock);
+}
+
+static Future *submit_action(RDD *rdd, Printer p) {
+    Future *future = (Future *)malloc(sizeof(Future));
+    if (future == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    future->printer = p;
+    future->result = 0;
+    future->done = 0;
+    future->settled = 0;
+    future->callback = NULL;
+    future->arg = NULL;
+    pthread_mutex_init(&future->lock, NULL);
+    pthread_cond_init(&future->settledCond, NULL);
+    // the job may complete, and call complete_future(), right away
+    future->job = submit_job(rdd, 1, complete_future, future);
+    return future;
+}
+
+Future *count_async(RDD *rdd) {
+    return submit_action(rdd, NULL);
+}
+
+Future *print_async(RDD *rdd, Printer p) {
+    return submit_action(rdd, p);
+}
+
+int future_poll(Future *future) {
+    pthread_mutex_lock(&future->lock);
+    int done = future->done;
+    pthread_mutex_unlock(&future->lock);
+    return done;
+}
+
+void future_then(Future *future, Callback fn, void *arg) {
+    pthread_mutex_lock(&future->lock);
+    int done = future->done;
+    if (!done) {
+        future->callback = fn;
+        future->arg = arg;
+    }
+    long result = future->result;
+    pthread_mutex_unlock(&future->lock);
+    if (done) {
+        fn(result, arg);
+    }
+}
+
+long future_wait(Future *future) {
+    pthread_mutex_lock(&future->lock);
+    while (!future->settled) {
+        pthread_cond_wait(&future->settledCond, &future->lock);
     }
+    long result = future->result;
+    pthread_mutex_unlock(&future->lock);
 
-    // free_All_RDD(rdd);
+    MS_JobWait(future->job);
+    pthread_mutex_destroy(&future->lock);
+    pthread_cond_destroy(&future->settledCond);
+    free(future);
+    return result;
 }
@@ -2,8 +2,11 @@
 #define __minispark_h__
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
 
 #include "list.h"
+#include "vector.h"
 
 #define MAXDEPS (2)
 #define TIME_DIFF_MICROS(start, end)            \
@@ -12,11 +15,55 @@
 
 #define METRIC_QUEUE_CAPACITY 1024
 
+// Partitions whose input is bigger than one morsel are computed by
+// several tasks, one per morsel, and stitched back together in order.
+#define MORSEL_SIZE (4096)            // elements of a stored partition
+#define MORSEL_BYTES (1 << 20)        // bytes of a text file
+#define MORSEL_JOIN_PAIRS (1 << 20)   // Joiner calls of a nested-loop join
+
+// Hash join partitions are split into morsels when a sample of this many
+// rows of each input estimates more than MORSEL_JOIN_PAIRS Joiner calls.
+// The rows of hot keys, those estimated to make that many calls on their
+// own, are spread over all the morsels.
+#define JOIN_SAMPLE_SIZE (1024)
+
+// take() computes this many times more partitions with every batch
+#define TAKE_SCALE_UP (4)
+
+// sortBy() samples about this many elements per output partition, over
+// sampling each input partition three times to even out their sizes
+#define SORT_SAMPLE_SIZE (20)
+
+// DAGs this small, whose stages all ran before and took this little
+// time, are computed by the calling thread itself, skipping the
+// workers, the task allocations and the metric log. A stage counts as
+// run before when a stage of the same transformations and functions
+// over the same kind of input did, even in another DAG.
+#define INLINE_MAX_TASKS (8)
+#define INLINE_MAX_BYTES (32 << 10)  // of input files
+#define INLINE_MAX_ELEMS (1024)      // of stored input partitions
+#define INLINE_MAX_USEC (1000)       // as estimated from earlier runs
+
+// A task of a speculate()d stage that has run this many times longer
+// than the median task of its RDD, once half of the RDD's partitions are
+// stored, gets a second copy on an idle worker.
+#define SPECULATION_MULTIPLIER (4)
+#define SPECULATION_MIN_USEC (10000)  // never copy tasks shorter than this
+#define TASK_TIME_SAMPLES (64)  // run times kept per RDD for the median
+
 struct RDD;
 struct List;
+struct Job;
+struct PriorityQueue;
+struct HashTable;
+struct BloomFilter;
+struct Arena;
+struct Take;
 
 typedef struct RDD RDD;    // forward decl. of struct RDD
 typedef struct List List;  // forward decl. of List.
+typedef struct Job Job;    // forward decl. of struct Job
+typedef struct Future Future;  // see count_async()
 // Minimally, we assume "list_add_elem(List *l, void*)"
 
 // Different function pointer types used by minispark
@@ -25,14 +72,33 @@ typedef int (*Filter)(void* arg, void* pred);
 typedef void* (*Joiner)(void* arg1, void* arg2, void* arg);
 typedef unsigned long (*Partitioner)(void* arg, int numpartitions, void* ctx);
 typedef void (*Printer)(void* arg);
+typedef void (*Destructor)(void* arg);
+typedef unsigned long (*Hasher)(void* arg, void* ctx);
+typedef void* (*Reducer)(void* arg1, void* arg2, void* ctx);
+typedef void (*Callback)(long result, void* arg);
+// negative, zero or positive as "arg1" orders before, with or after "arg2"
+typedef int (*Comparator)(void* arg1, void* arg2, void* ctx);
 
-typedef enum { MAP, FILTER, JOIN, PARTITIONBY, FILE_BACKED } Transform;
+typedef enum {
+    MAP,
+    FILTER,
+    JOIN,
+    PARTITIONBY,
+    AGGREGATEBYKEY,
+    SORTBY,
+    BROADCASTJOIN,
+    SEMIJOIN,
+    FILE_BACKED
+} Transform;
 
 struct RDD {
     Transform trans;   // transform type, see enum
     void* fn;          // transformation function
     void* ctx;         // used by minispark lib functions
-    List* partitions;  // list of partitions
+    Hasher keyhash;    // key hash for hash-based operators, or NULL
+    Mapper init;       // AGGREGATEBYKEY: makes an element a partial result
+    List* partitions;  // Vectors of elements, or FILE*s if FILE_BACKED
+    char** filenames;  // RDDFromTextFiles only, reopened by file morsels
 
     RDD* dependencies[MAXDEPS];
     int numdependencies;  // 0, 1, or 2
@@ -41,6 +107,70 @@ struct RDD {
     int numpartitions;
     int numComputed;
     pthread_mutex_t partitionListLock;
+
+    // DAG scheduling state, rebuilt by execute() for every action
+    Job* job;             // stage tops: the job computing it, else NULL
+    List* dependents;     // stage tops of the current DAG that read this one
+    int* pendingDeps;     // per input task: input partitions not stored yet
+    int fused;            // computed inside its consumer's task, not stored
+    int numfused;         // stage tops: fused RDDs right below this one
+    unsigned long shape;  // stage tops: what their tasks run, see execute()
+    int idempotent;       // set by speculate(): fn may safely run twice
+    long priority;        // estimated critical path to the action's RDD
+
+    // run times of this RDD's tasks so far, in usec, see record_task_time()
+    long taskTime;
+    long numTimed;
+    long taskTimes[TASK_TIME_SAMPLES];  // a uniform sample of them
+    unsigned int timeSeed;              // picks the samples replaced
+
+    // PARTITIONBY, AGGREGATEBYKEY and SORTBY only: bucket [input
+    // partition][output partition] of the map-side shuffle, and how many
+    // map-side tasks have finished. A SORTBY keeps each sorted input
+    // partition in its bucket 0.
+    Vector** shuffle;
+    int numShuffled;
+
+    // SORTBY only: the SortSamples of the sorted input partitions, and
+    // the elements they pick once every input is sorted. Output
+    // partition p gets the elements ordering after bounds[p - 1] and not
+    // after bounds[p].
+    List* samples;
+    void** bounds;
+    int numbounds;
+
+    // broadcast and bloom are built under buildLock, so the other tasks
+    // of the RDD do not wait for them, and published under
+    // partitionListLock.
+    pthread_mutex_t buildLock;
+
+    // BROADCASTJOIN only: every partition of the second input, hashed
+    // once by the first task that probes it, until the RDD is computed
+    struct HashTable* broadcast;
+
+    // SEMIJOIN only: the key hashes of every element of the second
+    // input, added by the first task that filters, until the RDD is
+    // computed
+    struct BloomFilter* bloom;
+
+    // What MS_Alloc() handed out while computing each stored partition,
+    // and, for shuffles, in the map-side tasks. Freed with the RDD.
+    struct Arena** arenas;
+    struct Arena* shared;
+
+    // Stage tops other than the action's RDD: per partition, the tasks
+    // of the current DAG that have yet to read it. The last one to read
+    // a partition releases it, see release_partition(). NULL when the
+    // RDD stays stored: it is the action's RDD, was stored before the
+    // action, or is read by a speculated stage. "numheld" counts the
+    // partitions still to be released, plus one until the RDD's own
+    // tasks are all done; the RDD's job is kept until both are done.
+    int* readers;
+    int numheld;
+
+    // set by ownElements()
+    int owned;
+    Destructor destroy;
 };
 
 typedef struct {
@@ -49,14 +179,84 @@ typedef struct {
     size_t duration;  // in usec
     RDD* rdd;
     int pnum;
+    struct Task* task;  // whose slot this is, see thread_pool_new_task()
 } TaskMetric;
 
+typedef enum {
+    PARTITION_TASK,    // computes (for shuffles: gathers) partition pnum
+    SHUFFLE_MAP_TASK,  // buckets input partition pnum of a shuffle
+    MORSEL_TASK,       // computes one morsel of partition pnum
+    TAKE_TASK,         // computes partition pnum for take(), unstored
+} TaskKind;
+
+// A partition computed as several morsels. Each morsel covers an equal
+// slice of the "size" units of input; the task that finishes last
+// stitches the outputs together and stores the partition.
+typedef struct {
+    int nummorsels;
+    int numdone;  // guarded by the RDD's partitionListLock
+    long size;    // input elements, outer join rows, probe rows, or file bytes
+    Vector** out; // output of each morsel, in input order
+    struct Arena** arenas;  // what each morsel MS_Alloc()ed
+
+    // Hash joins only. Each morsel probes its slice of the rows of cold
+    // keys, and every nummorsels-th row of a hot key. The first morsel
+    // to run builds the table and hashes the probe rows for all of
+    // them, under buildLock, and publishes the table under the RDD's
+    // partitionListLock.
+    pthread_mutex_t buildLock;
+    struct HashTable* hot;    // hashes of the hot keys, or NULL
+    struct HashTable* table;  // of the build side, NULL until built
+    unsigned long* hashes;    // of each probe row
+    long* hotrows;            // the probe rows of hot keys, in order
+    long numhotrows;
+} Morsels;
+
+// An element of a sorted input partition of a SORTBY, standing in for
+// "weight" elements of that partition when the bounds are picked.
 typedef struct {
+    void* elem;
+    double weight;
+} SortSample;
+
+typedef struct Task {
     RDD* rdd;
     int pnum;
+    TaskKind kind;
+    Morsels* morsels;  // MORSEL_TASK only
+    int morsel;        // index of this task's morsel
+    long priority;     // tasks with longer critical paths run first
+    int speculative;   // a straggling run may be duplicated
+    atomic_int copied; // a speculative copy of this task was started
+    atomic_int done;   // the first of the two runs to finish sets this
+    struct Task* original;  // for a speculative copy, the task it copies
+    Job* job;
+    atomic_int* cancel;  // once set, the task may stop early, or NULL
+    struct Take* take;   // TAKE_TASK only: the take() it works for
+    Vector* output;      // TAKE_TASK only: the partition, for task_done()
     TaskMetric* metric;
+    TaskMetric slot;     // where "metric" points unless the task is inline
+    atomic_int refs;     // its run, its metric's log entry and a copy's run
 } Task;
 
+// One action computed by the thread pool. Concurrent jobs share the
+// workers in proportion to their weights: an idle worker takes the next
+// task of the job that has received the least worker time per unit of
+// weight so far.
+struct Job {
+    RDD* rdd;        // the action's RDD
+    int weight;      // relative share of the workers, at least 1
+    atomic_long vruntime;   // worker time received, in usec / weight
+    atomic_int numQueued;   // tasks waiting in the job's queues
+    atomic_int numTasks;    // tasks run so far, speculative copies included
+    atomic_long taskTime;   // their total run time, in usec
+    atomic_int refs;        // the handle, plus each task not finished yet
+    void (*finish)(Job* job);  // run once rdd is computed, or NULL
+    void* arg;                 // for finish
+    struct PriorityQueue** queues;  // one per worker, see thread_pool.c
+    struct Job* deferred;  // next job waiting to be planned, see execute()
+};
+
 typedef struct MetricQueue {
     List* queue;
     pthread_mutex_t queue_lock;
@@ -66,8 +266,59 @@ typedef struct MetricQueue {
 
 //////// actions ////////
 
+// Start computing "dataset" as a job that gets "weight" times the share
+// of the workers a job of weight 1 gets, and return without waiting.
+// Jobs may be submitted by several application threads at once. If
+// another job is computing part of the same DAG, the new job is planned
+// once that part is done, by whichever thread finishes it.
+Job* MS_JobSubmit(RDD* dataset, int weight);
+
+// Wait until every partition of the job's RDD is stored, then release
+// the handle.
+void MS_JobWait(Job* job);
+
+// Like count() and print(), but return a future at once. The action's
+// result (0 for print_async) is computed, and the elements printed, by
+// the thread that stores the last partition. Every future must be
+// waited for exactly once with future_wait().
+Future* count_async(RDD* dataset);
+Future* print_async(RDD* dataset, Printer p);
+
+// Copy the first "n" elements of "dataset", in partition order, into
+// "out" and return how many there were. A final chain of MAP and FILTER
+// RDDs is computed a few partitions at a time, starting with one and
+// growing by TAKE_SCALE_UP, until "n" elements are found; partitions
+// still running by then are cancelled. The elements are not stored in
+// "dataset", which stays uncomputed. Any other RDD is computed whole.
+long take(RDD* dataset, long n, void** out);
+
+// The first element of "dataset", or NULL if it is empty.
+void* first(RDD* dataset);
+
+// Copy the "k" smallest elements of "dataset" as ordered by "fn" into
+// "out", in ascending order, and return how many there were. Every
+// partition of a narrow "dataset" is computed by its own task, which
+// keeps only about its "k" smallest elements as they are produced;
+// those are merged once all tasks are done, and not stored in
+// "dataset", like with take(). Otherwise "dataset" is computed and
+// stored first. "ctx" is passed to "fn".
+long takeOrdered(RDD* dataset, long k, Comparator fn, void* ctx,
+                 void** out);
+
+// Whether the action of "future" is complete.
+int future_poll(Future* future);
+
+// Call "fn" with the result and "arg" once the action is complete, on
+// the thread completing it, or right away if it already is. A future
+// takes at most one callback, which must not wait for futures.
+void future_then(Future* future, Callback fn, void* arg);
+
+// Wait until the action and its callback are complete, release
+// "future" and return the result.
+long future_wait(Future* future);
+
 // Return the total number of elements in "dataset"
-int count(RDD* dataset);
+long count(RDD* dataset);
 
 // Print each element in "dataset" using "p".
 // For example, p(element) for all elements.
@@ -84,31 +335,154 @@ RDD* map(RDD* rdd, Mapper fn);
 // when it is called as a Filter
 RDD* filter(RDD* rdd, Filter fn, void* ctx);
 
+// Mark "rdd", a MAP or FILTER, as safe to run twice on the same input:
+// its function has no side effects and does not free its argument.
+// When a whole narrow stage over stored partitions is marked, its
+// straggling tasks are duplicated on idle workers and the first copy to
+// finish wins. Partitions split into morsels are not duplicated.
+// Returns "rdd".
+RDD* speculate(RDD* rdd);
+
+// Declare that no later RDD keeps the elements of "rdd": its consumers
+// build new elements rather than pass them on, unlike a FILTER, a
+// partitionBy() or a sortBy(). Once the last task reading a partition
+// of "rdd" is done, "fn" (if not NULL) is called on each of its
+// elements and the partition's MS_Alloc() memory is freed, as they are
+// by MS_TearDown() for partitions still stored. Returns "rdd".
+RDD* ownElements(RDD* rdd, Destructor fn);
+
 // Create an RDD with two dependencies, "rdd1" and "rdd2"
 // "ctx" should be passed to "fn" when it is called as a
 // Joiner.
 RDD* join(RDD* rdd1, RDD* rdd2, Joiner fn, void* ctx);
 
+// Like join(), but builds a hash table on the smaller of the two
+// co-partitioned inputs using "hash" as the key hash, and only calls
+// "fn" on the pairs whose keys hash equally, so each partition is
+// joined in linear time. "fn" still decides whether the keys match.
+// "ctx" is passed to both "fn" and "hash".
+RDD* hashJoin(RDD* rdd1, RDD* rdd2, Joiner fn, Hasher hash, void* ctx);
+
+// Like hashJoin(), for a small "rdd2" and inputs that need not be
+// co-partitioned: every partition of "rdd2" is hashed into one table
+// shared by all tasks, which each probe it with one partition of
+// "rdd1". The new RDD has the partitions of "rdd1", which is neither
+// shuffled nor waited for as a whole; "rdd2" is, so it should be
+// computed cheaply and fit in memory.
+RDD* broadcastJoin(RDD* rdd1, RDD* rdd2, Joiner fn, Hasher hash, void* ctx);
+
+// Create an RDD with the elements of "rdd" whose key, as hashed by
+// "hash", may also be the key of an element of "keys", to drop rows
+// that cannot match before "rdd" is shuffled for a join with "keys".
+// The key hashes of all of "keys" are added to one Bloom filter, which
+// lets through about 1% of the rows without a match; the join still
+// decides which keys match. Like a FILTER, it is computed in the same
+// pass as the MAP and FILTER RDDs below it, so the dropped rows are
+// never stored. "ctx" is passed to "hash".
+RDD* semiJoinFilter(RDD* rdd, RDD* keys, Hasher hash, void* ctx);
+
 // Create an RDD with "rdd" as a dependency. The new RDD
 // will have "numpartitions" number of partitions, which
 // may be different than its dependency. "ctx" should be
 // passed to "fn" when it is called as a Partitioner.
 RDD* partitionBy(RDD* rdd, Partitioner fn, int numpartitions, void* ctx);
 
+// Create an RDD with "numpartitions" partitions and one element per
+// distinct key of "rdd". "fn" merges two elements into one and returns
+// it, or returns NULL when their keys differ, like the Joiner of
+// hashJoin(); it must not modify its arguments. "hash" hashes the key of
+// an element, and also picks the partition of its key. Elements are
+// merged within each input partition before they are shuffled, so at
+// most one element per key and input partition is moved, and the
+// partial results are merged after the shuffle. "ctx" is passed to
+// both "fn" and "hash".
+RDD* reduceByKey(RDD* rdd, Reducer fn, Hasher hash, int numpartitions,
+                 void* ctx);
+
+// Like reduceByKey(), but each element of "rdd" is first turned into a
+// partial result by "init", or dropped if it returns NULL. "fn" merges
+// partial results and "hash" hashes their keys.
+RDD* aggregateByKey(RDD* rdd, Mapper init, Reducer fn, Hasher hash,
+                    int numpartitions, void* ctx);
+
+// Create an RDD with "numpartitions" partitions holding the elements of
+// "rdd" in ascending order of "fn": partition by partition, and within
+// each partition. Each input partition is sorted by its own task and
+// sampled; the samples pick the range of elements each output partition
+// gets, which then merges its slice of every sorted input. Elements
+// that order equally may come in any order. "ctx" is passed to "fn".
+RDD* sortBy(RDD* rdd, Comparator fn, int numpartitions, void* ctx);
+
 // Create an RDD which opens a list of files, one per
 // partition. The number of partitions in the RDD will be
 // equivalent to "numfiles."
 RDD* RDDFromFiles(char* filenames[], int numfiles);
 
+// Like RDDFromFiles(), for text files whose first map reads one line
+// per call (e.g. GetLines). Big files are then read as several byte
+// ranges in parallel, each starting at the first line inside it.
+RDD* RDDFromTextFiles(char* filenames[], int numfiles);
+
 //////// MiniSpark ////////
-// Submits work to the thread pool to materialize "rdd".
-void execute(RDD* rdd);
+// Submits work to the thread pool to materialize "rdd" as part of
+// "job", or computes it on the calling thread when the DAG is tiny,
+// see INLINE_MAX_TASKS. Readiness is tracked per partition: only the
+// tasks whose input partitions are already stored are submitted, the
+// rest are released by task_done() as those partitions are stored.
+// Only "rdd" and the inputs of speculated stages stay stored: the
+// partitions of the other RDDs below it are freed as soon as every task
+// reading them is done, so a later action over them computes them again.
+// A DAG overlapping a stage another job is computing is deferred until
+// that stage is done, then planned by the thread finishing it, and
+// never computed inline.
+void execute(RDD* rdd, Job* job);
+
+// Called by the worker that finished "task", once its output is
+// stored. Records the progress of the task's RDD and submits whatever
+// that unblocks: the gather side of a shuffle once every map-side task
+// is done, or the tasks of dependent RDDs that read the same partition
+// number and have no other input partition left to wait for.
+void task_done(Task* task);
 
-// Creates the thread pool and monitoring thread.
+// Called by the worker running TAKE_TASK "task" after each element it
+// appends to "out". For takeOrdered(), cuts "out" down to the "k"
+// smallest elements once it holds twice as many.
+void take_trim(Task* task, Vector* out);
+
+// Whether "task", running for "elapsed" usec, is a straggler worth
+// running a second copy of. Only asked about speculative tasks.
+int is_straggler(Task* task, long elapsed);
+
+// Make MS_Alloc() on the calling thread allocate from a new arena, for
+// a task that is about to run, until end_task_arena() returns that
+// arena (NULL if nothing was allocated) for the task to keep with its
+// output.
+void begin_task_arena();
+struct Arena* end_task_arena();
+
+// Called by the worker that ran "task", once its duration is measured.
+// Feeds the run time estimates that execute() turns into priorities:
+// the tasks on the longest remaining chain to the action run first.
+void record_task_time(Task* task);
+
+// Creates the thread pool and monitoring thread. Setting the
+// MINISPARK_PIN_WORKERS environment variable pins each worker to its own
+// CPU, see thread_pool.h.
 void MS_Run();
 
 // Waits for work to be complete, destroys the thread pool, and frees
 // all RDDs allocated during runtime.
 void MS_TearDown();
 
+// Allocate "size" bytes, aligned for any type, that live as long as the
+// partition being computed. Called from a Mapper, Filter, Joiner or
+// other function of a task, the memory is bumped off an arena of the
+// task's own, without locking, and kept with the partition it computes;
+// MS_TearDown() frees it with the RDD, one chunk at a time instead of
+// one element at a time, unless ownElements() lets it go sooner. Called
+// outside a task, or by a task of take() whose output is not stored, it
+// comes from one shared arena that also lives until MS_TearDown(). Never
+// pass it to free().
+void* MS_Alloc(size_t size);
+
 #endif  // __minispark_h__
@@ -0,0 +1,98 @@
+#include "pqueue.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+PriorityQueue* pqueue_init(int capacity) {
+    PriorityQueue* q = (PriorityQueue*)malloc(sizeof(PriorityQueue));
+    if (q == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    assert(capacity > 0);
+    atomic_init(&q->nonempty, 0);
+    q->capacity = capacity;
+    for (int b = 0; b < PQUEUE_BUCKETS; ++b) {
+        atomic_init(&q->buckets[b], NULL);
+    }
+    return q;
+}
+
+// bucket of "key": the index of its highest bit, plus one
+static int __bucket(long key) {
+    unsigned long k = key > 0 ? (unsigned long)key + 1 : 1;
+    return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl(k);
+}
+
+void pqueue_push(PriorityQueue* q, void* elem, long key) {
+    int b = __bucket(key);
+    Deque* d = atomic_load(&q->buckets[b]);
+    if (d == NULL) {
+        // whoever installs it first wins, the others free theirs
+        Deque* fresh = deque_init(q->capacity);
+        if (atomic_compare_exchange_strong(&q->buckets[b], &d, fresh)) {
+            d = fresh;
+        } else {
+            free_deque(fresh);
+        }
+    }
+    deque_push_bottom(d, elem);
+    unsigned long bit = 1UL << b;
+    if ((atomic_load(&q->nonempty) & bit) == 0) {
+        atomic_fetch_or(&q->nonempty, bit);
+    }
+}
+
+// Take an element from the highest non-empty bucket with "take".
+static void* __take(PriorityQueue* q, void* (*take)(Deque*)) {
+    unsigned long mask = atomic_load(&q->nonempty);
+    while (mask != 0) {
+        int b = (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl(mask);
+        unsigned long bit = 1UL << b;
+        Deque* d = atomic_load(&q->buckets[b]);
+        void* elem = take(d);
+        if (elem) {
+            return elem;
+        }
+        // A pusher sets the bit after its push, so either it sees the
+        // bit cleared and sets it again, or we see its element here.
+        atomic_fetch_and(&q->nonempty, ~bit);
+        if (deque_size(d) > 0) {
+            atomic_fetch_or(&q->nonempty, bit);
+            mask = atomic_load(&q->nonempty);
+        } else {
+            mask = atomic_load(&q->nonempty) & (bit - 1);
+        }
+    }
+    return NULL;
+}
+
+void* pqueue_pop(PriorityQueue* q) {
+    return __take(q, deque_pop_bottom);
+}
+
+void* pqueue_steal(PriorityQueue* q) {
+    return __take(q, deque_steal_top);
+}
+
+int pqueue_size(PriorityQueue* q) {
+    int size = 0;
+    for (int b = 0; b < PQUEUE_BUCKETS; ++b) {
+        Deque* d = atomic_load(&q->buckets[b]);
+        if (d) {
+            size += deque_size(d);
+        }
+    }
+    return size;
+}
+
+void free_pqueue(PriorityQueue* q) {
+    if (q) {
+        for (int b = 0; b < PQUEUE_BUCKETS; ++b) {
+            free_deque(atomic_load(&q->buckets[b]));
+        }
+        free((void*)q);
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * @file pqueue.h
+ * @author
+ * @brief Definition of a priority queue of tasks used by the workers
+ * @version 0.1
+ * @date 2025-04-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef __PQUEUE_H__
+#define __PQUEUE_H__
+
+#include <stdatomic.h>
+
+#include "deque.h"
+
+#define PQUEUE_BUCKETS 64 /**< One per bit of a key */
+
+/**
+ * @brief Work-stealing deques, one per priority bucket.
+ *
+ * Each worker owns one queue. An element of key k goes to bucket
+ * floor(log2(k + 1)), so keys within a factor of two of each other
+ * share a bucket. Both the owner and thieves take from the highest
+ * non-empty bucket: the owner its newest element, so it runs the task
+ * it just unblocked while its inputs are in cache, and thieves the
+ * oldest one. Within a bucket a push or pop costs a deque operation,
+ * and the bucket is found from a bitmask without locking.
+ */
+typedef struct PriorityQueue {
+    atomic_ulong nonempty; /**< Bit b is set while bucket b may be non-empty */
+    int capacity;          /**< Initial capacity of each bucket's deque */
+    _Atomic(Deque*) buckets[PQUEUE_BUCKETS]; /**< Allocated on first use */
+} PriorityQueue;
+
+/**
+ * @brief Initialize a new, empty queue. A bucket's deque is only
+ * allocated once an element is pushed to it.
+ *
+ * @param capacity The initial capacity of every bucket, grown by
+ * DEQUE_GROWTH_FACTOR whenever it is full.
+ * @return PriorityQueue* Pointer to the newly created queue.
+ */
+PriorityQueue* pqueue_init(int capacity) __attribute__((warn_unused_result));
+
+/**
+ * @brief Add an element with priority "key", at least 0.
+ *
+ * @param q Pointer to the queue.
+ * @param elem Generic pointer to the element to add.
+ * @param key The priority of the element.
+ */
+void pqueue_push(PriorityQueue* q, void* elem, long key);
+
+/**
+ * @brief Remove the newest element of the highest bucket (owner side).
+ *
+ * @param q Pointer to the queue.
+ * @return The element, or NULL if the queue is empty.
+ */
+void* pqueue_pop(PriorityQueue* q);
+
+/**
+ * @brief Remove the oldest element of the highest bucket (thief side).
+ *
+ * @param q Pointer to the queue.
+ * @return The element, or NULL if the queue is empty.
+ */
+void* pqueue_steal(PriorityQueue* q);
+
+/**
+ * @brief Number of elements currently in the queue.
+ *
+ * @param q Pointer to the queue.
+ * @return int The number of elements.
+ */
+int pqueue_size(PriorityQueue* q);
+
+/**
+ * @brief Free the queue structure.
+ *
+ * Like free_list(), the elements themselves are not freed.
+ *
+ * @param q Pointer to the queue to free.
+ */
+void free_pqueue(PriorityQueue* q);
+
+#endif  // !__PQUEUE_H__
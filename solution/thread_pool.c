@@ -3,31 +3,68 @@
 
 #include <assert.h>
 #include <bits/time.h>
+#include <dirent.h>
+#include <errno.h>
 #include <pthread.h>
 #include <sched.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "arena.h"
+#include "bloom.h"
+#include "freelist.h"
+#include "hashtable.h"
 #include "list.h"
 #include "minispark.h"
+#include "pqueue.h"
+#include "vector.h"
 
-#define QUEUE_CAPACITY 1024
+#define PQUEUE_INIT_CAPACITY 64
+#define SPECULATION_INTERVAL_USEC 10000  // idle workers look for stragglers
+#define JOBS_INIT_CAPACITY 4
+#define VRUNTIME_SCALE 1024  // vruntime per usec of work of a weight 1 job
 
 typedef struct {
-    pthread_t *threads;
+    pthread_t thread;
+    int id;                // index of this worker's queue in every job
+    unsigned int seed;     // picks the first victim when stealing
+    int cpu;               // CPU the worker is pinned to, or -1
+    int node;              // NUMA node of that CPU, 0 when not pinned
+    Task *running;         // speculative task being run, under spec_lock
+    FreeCache tasks;       // free tasks only this worker takes or returns
+} Worker;
+
+typedef struct {
+    Worker *workers;
     int num_thread;
-    List *task_queue;
-    int num_task;
+    atomic_uint next_victim;     // round-robin target for outside submits
+    atomic_int num_queued;       // tasks sitting in any worker queue
+    atomic_int num_sleeping;     // workers parked on queue_not_empty
+    atomic_int num_outstanding;  // submitted tasks that have not finished
+    atomic_int num_watched;      // speculative tasks being run
+    bool shutdown;               // set by thread_pool_destroy()
+    pthread_mutex_t spec_lock;   // guards every worker's `running`
+    FreeList *tasks;             // recycled Tasks, with their metrics
+
+    Job **jobs;  // jobs whose tasks the workers pick from
+    int num_jobs;
+    int jobs_capacity;
+    pthread_rwlock_t jobs_lock;  // written only to add or remove a job
 
     pthread_mutex_t queue_lock;
     pthread_cond_t queue_not_empty;
-    pthread_cond_t queue_not_full;
+    pthread_cond_t all_done;
 } ThreadPool;
 
 ThreadPool pool;
 
+// the worker running on this thread, NULL on the driver thread
+static __thread Worker *current_worker = NULL;
+
 int get_num_threads() {
     cpu_set_t set;
     CPU_ZERO(&set);
@@ -42,126 +79,722 @@ int get_num_threads() {
 
 extern MetricQueue *metric_queue;
 
-static void do_computation(Task *topTask) {
-    struct timespec start;
-    struct timespec end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    bool waitDependencies = true;
+// Run "elem" through the fused MAP/FILTER RDDs "ops", bottom-up.
+// Returns NULL when a filter drops the element.
+static void *apply_narrow(RDD **ops, int numops, void *elem) {
+    for (int i = 0; i < numops && elem != NULL; ++i) {
+        if (ops[i]->trans == MAP) {
+            elem = ((Mapper)(ops[i]->fn))(elem);
+        } else if (ops[i]->trans == SEMIJOIN) {
+            unsigned long hash = ops[i]->keyhash(elem, ops[i]->ctx);
+            if (!bloom_may_contain(ops[i]->bloom, hash)) {
+                elem = NULL;
+            }
+        } else if (!((Filter)(ops[i]->fn))(elem, ops[i]->ctx)) {
+            elem = NULL;
+        }
+    }
+    return elem;
+}
+
+// Whether this run may stop: the other run of a speculated task already
+// finished, so its output will be dropped, or the task was cancelled.
+static bool run_lost(Task *task) {
+    Task *original = task->original ? task->original : task;
+    return (task->speculative && atomic_load(&original->done)) ||
+           (task->cancel && atomic_load(task->cancel));
+}
+
+// Slice of an input of "size" units that "task" computes: all of it, or
+// the share of the task's morsel.
+static void morsel_range(Task *task, long size, long *lo, long *hi) {
+    if (task->morsels == NULL) {
+        *lo = 0;
+        *hi = size;
+        return;
+    }
+    Morsels *morsels = task->morsels;
+    *lo = morsels->size * task->morsel / morsels->nummorsels;
+    *hi = morsels->size * (task->morsel + 1) / morsels->nummorsels;
+}
+
+// Append "elem" to "out", the output of "task".
+static inline void emit(Task *task, Vector *out, void *elem) {
+    vector_append(out, elem);
+    if (task->kind == TAKE_TASK) {
+        take_trim(task, out);
+    }
+}
+
+// Read the lines starting in bytes [lo, hi) of text file "task->pnum"
+// of "source" through its own FILE*, and run them through "ops". ops[0]
+// is the MAP that reads one line per call.
+static void read_file_morsel(Task *task, RDD *source, long lo, long hi,
+                             RDD **ops, int numops, Vector *out) {
+    FILE *fp = fopen(source->filenames[task->pnum], "r");
+    if (fp == NULL) {
+        perror("fopen");
+        exit(EXIT_FAILURE);
+    }
+    if (lo > 0) {
+        // the line running into lo belongs to the previous morsel
+        fseek(fp, lo - 1, SEEK_SET);
+        int c;
+        while ((c = fgetc(fp)) != EOF && c != '\n') {
+        }
+    }
+
+    void *line = NULL;
+    while (ftell(fp) < hi && !run_lost(task) &&
+           (line = ((Mapper)(ops[0]->fn))(fp)) != NULL) {
+        void *elem = apply_narrow(ops + 1, numops - 1, line);
+        if (elem) {
+            emit(task, out, elem);
+        }
+    }
+    fclose(fp);
+}
+
+// Compute partition "pnum" of the narrow stage topped by "task->rdd", or
+// the task's morsel of it: every input element flows through the whole
+// chain of fused MAP/FILTER RDDs in one pass, and only the survivors are
+// stored in "out".
+static void compute_narrow_stage(Task *task, Vector *out) {
+    RDD *top = task->rdd;
+    int pnum = task->pnum;
+    int numops = top->numfused + 1;
+    RDD *ops[numops];  // ops[0] reads the stage input
+    RDD *source = top;
+    for (int i = numops - 1; i >= 0; --i) {
+        ops[i] = source;
+        source = source->dependencies[0];
+    }
+
+    long lo, hi;
+    if (source->trans == FILE_BACKED && task->morsels) {
+        morsel_range(task, 0, &lo, &hi);
+        read_file_morsel(task, source, lo, hi, ops, numops, out);
+    } else if (source->trans == FILE_BACKED) {
+        // partition with a single FilePointer inside, which a stage of
+        // another job may be reading at the same time
+        FILE *fp = (FILE *)get_nth_elem(source->partitions, pnum);
+        flockfile(fp);
+        // a later action of the session may read this file again
+        rewind(fp);
+        if (ops[0]->trans != MAP) {
+            void *elem = apply_narrow(ops, numops, fp);
+            if (elem) {
+                emit(task, out, elem);
+            }
+        } else {
+            void *line = NULL;
+            while (!run_lost(task) &&
+                   (line = ((Mapper)(ops[0]->fn))(fp)) != NULL) {
+                void *elem = apply_narrow(ops + 1, numops - 1, line);
+                if (elem) {
+                    emit(task, out, elem);
+                }
+            }
+        }
+        funlockfile(fp);
+    } else {  // partition with finite regular elements
+        Vector *in = (Vector *)get_nth_elem(source->partitions, pnum);
+        morsel_range(task, vector_size(in), &lo, &hi);
+        for (long i = lo; i < hi && !run_lost(task); ++i) {
+            void *elem = apply_narrow(ops, numops, vector_get(in, i));
+            if (elem) {
+                emit(task, out, elem);
+            }
+        }
+    }
+}
+
+static HashTable *build_table(RDD *rdd, Vector *build) {
+    // inserting backwards leaves every bucket in input order
+    HashTable *table = hashtable_init(vector_size(build));
+    for (long i = vector_size(build) - 1; i >= 0; --i) {
+        void *elem = vector_get(build, i);
+        hashtable_insert(table, rdd->keyhash(elem, rdd->ctx), elem);
+    }
+    return table;
+}
+
+// Join probe row "elem", whose key hashes to "hash", with its matches
+// in "table".
+static void probe_table(RDD *rdd, HashTable *table, bool buildLeft,
+                        void *elem, unsigned long hash, Vector *out) {
+    long match = hashtable_find(table, hash);
+    for (; match != -1; match = hashtable_find_next(table, match)) {
+        void *other = table->entries[match].value;
+        void *joined = buildLeft ? ((Joiner)(rdd->fn))(other, elem, rdd->ctx)
+                                 : ((Joiner)(rdd->fn))(elem, other, rdd->ctx);
+        if (joined) {
+            vector_append(out, joined);
+        }
+    }
+}
+
+// Compute the morsel of a skewed hash join partition that "task" runs:
+// the rows of cold keys in its slice of "probe", and its share of the
+// rows of hot keys, probing the table shared by all the morsels.
+static void compute_join_morsel(Task *task, Vector *build, Vector *probe,
+                                bool buildLeft, Vector *out) {
+    RDD *rdd = task->rdd;
+    Morsels *morsels = task->morsels;
+    // The other morsels need the table too, so they may as well wait
+    // here. Tasks of the RDD's other partitions do not.
+    pthread_mutex_lock(&morsels->buildLock);
+    if (morsels->table == NULL) {
+        long size = vector_size(probe);
+        morsels->hashes =
+            (unsigned long *)malloc(sizeof(unsigned long) * (size + 1));
+        morsels->hotrows = (long *)malloc(sizeof(long) * (size + 1));
+        for (long i = 0; i < size; ++i) {
+            unsigned long hash = rdd->keyhash(vector_get(probe, i), rdd->ctx);
+            morsels->hashes[i] = hash;
+            if (morsels->hot && hashtable_find(morsels->hot, hash) != -1) {
+                morsels->hotrows[morsels->numhotrows++] = i;
+            }
+        }
+        HashTable *table = build_table(rdd, build);
+        pthread_mutex_lock(&(rdd->partitionListLock));
+        morsels->table = table;
+        pthread_mutex_unlock(&(rdd->partitionListLock));
+    }
+    pthread_mutex_unlock(&morsels->buildLock);
+
+    long lo, hi;
+    morsel_range(task, vector_size(probe), &lo, &hi);
+    for (long i = lo; i < hi; ++i) {
+        unsigned long hash = morsels->hashes[i];
+        if (morsels->hot == NULL ||
+            hashtable_find(morsels->hot, hash) == -1) {
+            probe_table(rdd, morsels->table, buildLeft,
+                        vector_get(probe, i), hash, out);
+        }
+    }
+    for (long i = task->morsel; i < morsels->numhotrows;
+         i += morsels->nummorsels) {
+        long row = morsels->hotrows[i];
+        probe_table(rdd, morsels->table, buildLeft, vector_get(probe, row),
+                    morsels->hashes[row], out);
+    }
+}
+
+// Join partition "pnum" of the two inputs of "task->rdd" by hashing the
+// smaller side and probing it with the larger one, or the task's morsel
+// of it. The Joiner is only called on pairs with equal key hashes, and
+// always with the element of the first input as its first argument.
+static void compute_hash_join(Task *task, Vector *out) {
+    RDD *rdd = task->rdd;
+    int pnum = task->pnum;
+    Vector *left =
+        (Vector *)get_nth_elem(rdd->dependencies[0]->partitions, pnum);
+    Vector *right =
+        (Vector *)get_nth_elem(rdd->dependencies[1]->partitions, pnum);
+    // on a tie, probe with the left side to keep join()'s output order
+    bool buildLeft = vector_size(left) < vector_size(right);
+    Vector *build = buildLeft ? left : right;
+    Vector *probe = buildLeft ? right : left;
+    if (task->morsels) {
+        compute_join_morsel(task, build, probe, buildLeft, out);
+        return;
+    }
+
+    HashTable *table = build_table(rdd, build);
+    for (long i = 0; i < vector_size(probe); ++i) {
+        void *elem = vector_get(probe, i);
+        probe_table(rdd, table, buildLeft, elem,
+                    rdd->keyhash(elem, rdd->ctx), out);
+    }
+    free_hashtable(table);
+}
+
+// Hash every partition of the second input of BROADCASTJOIN "rdd" into
+// one table, in input order, unless another task already did.
+static HashTable *broadcast_table(RDD *rdd) {
+    RDD *small = rdd->dependencies[1];
+    // the other tasks need the table too, so they may as well wait here
+    pthread_mutex_lock(&(rdd->buildLock));
+    if (rdd->broadcast == NULL) {
+        long size = 0;
+        for (int p = 0; p < small->numpartitions; ++p) {
+            size += vector_size(get_nth_elem(small->partitions, p));
+        }
+        HashTable *table = hashtable_init(size);
+        for (int p = small->numpartitions - 1; p >= 0; --p) {
+            Vector *part = (Vector *)get_nth_elem(small->partitions, p);
+            for (long i = vector_size(part) - 1; i >= 0; --i) {
+                void *elem = vector_get(part, i);
+                hashtable_insert(table, rdd->keyhash(elem, rdd->ctx), elem);
+            }
+        }
+        pthread_mutex_lock(&(rdd->partitionListLock));
+        rdd->broadcast = table;
+        pthread_mutex_unlock(&(rdd->partitionListLock));
+    }
+    HashTable *table = rdd->broadcast;
+    pthread_mutex_unlock(&(rdd->buildLock));
+    return table;
+}
+
+// Add the key hash of every element of the second input of SEMIJOIN
+// "rdd" to its Bloom filter, unless another task already did.
+static void build_bloom(RDD *rdd) {
+    RDD *keys = rdd->dependencies[1];
+    pthread_mutex_lock(&(rdd->buildLock));
+    if (rdd->bloom == NULL) {
+        long size = 0;
+        for (int p = 0; p < keys->numpartitions; ++p) {
+            size += vector_size(get_nth_elem(keys->partitions, p));
+        }
+        BloomFilter *bloom = bloom_init(size);
+        for (int p = 0; p < keys->numpartitions; ++p) {
+            Vector *part = (Vector *)get_nth_elem(keys->partitions, p);
+            for (long i = 0; i < vector_size(part); ++i) {
+                bloom_add(bloom, rdd->keyhash(vector_get(part, i), rdd->ctx));
+            }
+        }
+        pthread_mutex_lock(&(rdd->partitionListLock));
+        rdd->bloom = bloom;
+        pthread_mutex_unlock(&(rdd->partitionListLock));
+    }
+    pthread_mutex_unlock(&(rdd->buildLock));
+}
 
+// Join partition "pnum" of the first input of BROADCASTJOIN "rdd" with
+// the whole second input by probing the shared table.
+static void compute_broadcast_join(RDD *rdd, int pnum, Vector *out) {
+    Vector *probe =
+        (Vector *)get_nth_elem(rdd->dependencies[0]->partitions, pnum);
+    HashTable *table = broadcast_table(rdd);
+    for (long i = 0; i < vector_size(probe); ++i) {
+        void *elem = vector_get(probe, i);
+        long match = hashtable_find(table, rdd->keyhash(elem, rdd->ctx));
+        for (; match != -1; match = hashtable_find_next(table, match)) {
+            void *joined = ((Joiner)(rdd->fn))(
+                elem, table->entries[match].value, rdd->ctx);
+            if (joined) {
+                vector_append(out, joined);
+            }
+        }
+    }
+}
+
+// Map side of a PARTITIONBY: call the Partitioner once per row of input
+// partition "pnum" and append the row to that input's bucket for the
+// chosen output partition.
+static void shuffle_map(RDD *rdd, int pnum) {
+    Vector *in = (Vector *)get_nth_elem(rdd->dependencies[0]->partitions, pnum);
+    Vector **buckets = rdd->shuffle + (size_t)pnum * rdd->numpartitions;
+    for (long i = 0; i < vector_size(in); ++i) {
+        void *elem = vector_get(in, i);
+        unsigned long b = ((Partitioner)(rdd->fn))(elem, rdd->numpartitions,
+                                                   rdd->ctx);
+        if (b >= (unsigned long)rdd->numpartitions) {
+            continue;
+        }
+        if (buckets[b] == NULL) {
+            buckets[b] = vector_init();
+        }
+        vector_append(buckets[b], elem);
+    }
+}
+
+// Merge "elem" into the partial result of its key in "table", or make
+// it the first one of a new key. Entries stay in first-seen key order.
+static void combine_by_key(RDD *rdd, HashTable *table, void *elem) {
+    unsigned long hash = rdd->keyhash(elem, rdd->ctx);
+    long idx = hashtable_find(table, hash);
+    for (; idx != -1; idx = hashtable_find_next(table, idx)) {
+        void *merged =
+            ((Reducer)(rdd->fn))(table->entries[idx].value, elem, rdd->ctx);
+        if (merged) {
+            table->entries[idx].value = merged;
+            return;
+        }
+    }
+    hashtable_insert(table, hash, elem);
+}
+
+// Map side of an AGGREGATEBYKEY: merge the rows of input partition
+// "pnum" per key, then append each partial result to that input's
+// bucket for the partition of its key.
+static void aggregate_map(RDD *rdd, int pnum) {
+    Vector *in = (Vector *)get_nth_elem(rdd->dependencies[0]->partitions, pnum);
+    Vector **buckets = rdd->shuffle + (size_t)pnum * rdd->numpartitions;
+    if (rdd->numpartitions <= 0) {
+        return;
+    }
+    HashTable *table = hashtable_init(vector_size(in));
+    for (long i = 0; i < vector_size(in); ++i) {
+        void *elem = vector_get(in, i);
+        if (rdd->init) {
+            elem = rdd->init(elem);
+        }
+        if (elem) {
+            combine_by_key(rdd, table, elem);
+        }
+    }
+
+    for (long i = 0; i < table->size; ++i) {
+        HashEntry *entry = &table->entries[i];
+        unsigned long b = entry->hash % (unsigned long)rdd->numpartitions;
+        if (buckets[b] == NULL) {
+            buckets[b] = vector_init();
+        }
+        vector_append(buckets[b], entry->value);
+    }
+    free_hashtable(table);
+}
+
+// Reduce side of an AGGREGATEBYKEY: merge the partial results in the
+// buckets of output partition "pnum", in input partition order.
+static void aggregate_gather(RDD *rdd, int pnum, Vector *out) {
+    int numinputs = rdd->dependencies[0]->numpartitions;
+    long size = 0;
+    for (int i = 0; i < numinputs; ++i) {
+        Vector *bucket = rdd->shuffle[(size_t)i * rdd->numpartitions + pnum];
+        size += bucket ? vector_size(bucket) : 0;
+    }
+
+    HashTable *table = hashtable_init(size);
+    for (int i = 0; i < numinputs; ++i) {
+        Vector *bucket = rdd->shuffle[(size_t)i * rdd->numpartitions + pnum];
+        if (bucket == NULL) {
+            continue;
+        }
+        for (long j = 0; j < vector_size(bucket); ++j) {
+            combine_by_key(rdd, table, vector_get(bucket, j));
+        }
+        free_vector(bucket);
+    }
+    for (long i = 0; i < table->size; ++i) {
+        vector_append(out, table->entries[i].value);
+    }
+    free_hashtable(table);
+}
+
+// Reduce side of a PARTITIONBY: concatenate the buckets of output
+// partition "pnum" in input partition order.
+static void gather_shuffle(RDD *rdd, int pnum, Vector *out) {
+    int numinputs = rdd->dependencies[0]->numpartitions;
+    for (int i = 0; i < numinputs; ++i) {
+        Vector *bucket = rdd->shuffle[(size_t)i * rdd->numpartitions + pnum];
+        if (bucket == NULL) {
+            continue;
+        }
+        for (long j = 0; j < vector_size(bucket); ++j) {
+            vector_append(out, vector_get(bucket, j));
+        }
+        free_vector(bucket);
+    }
+}
+
+// qsort_r() comparison of two elements of SORTBY "arg".
+static int compare_elems(const void *a, const void *b, void *arg) {
+    RDD *rdd = (RDD *)arg;
+    return ((Comparator)(rdd->fn))(*(void *const *)a, *(void *const *)b,
+                                   rdd->ctx);
+}
+
+// Map side of a SORTBY: sort input partition "pnum" into bucket 0 of
+// that input, and sample it at even steps for the bounds of the output
+// partitions.
+static void sort_map(RDD *rdd, int pnum) {
+    Vector *in = (Vector *)get_nth_elem(rdd->dependencies[0]->partitions, pnum);
+    int numinputs = rdd->dependencies[0]->numpartitions;
+    if (rdd->numpartitions <= 0) {
+        return;
+    }
+    long size = vector_size(in);
+    void **elems = (void **)malloc(sizeof(void *) * (size > 0 ? size : 1));
+    for (long i = 0; i < size; ++i) {
+        elems[i] = vector_get(in, i);
+    }
+    qsort_r(elems, size, sizeof(void *), compare_elems, rdd);
+    Vector *run = vector_init();
+    for (long i = 0; i < size; ++i) {
+        vector_append(run, elems[i]);
+    }
+    rdd->shuffle[(size_t)pnum * rdd->numpartitions] = run;
+
+    long wanted = (3L * SORT_SAMPLE_SIZE * rdd->numpartitions + numinputs - 1) /
+                  numinputs;
+    long numsamples = wanted < size ? wanted : size;
+    pthread_mutex_lock(&(rdd->partitionListLock));
+    for (long i = 0; i < numsamples; ++i) {
+        SortSample *sample = (SortSample *)malloc(sizeof(SortSample));
+        sample->elem = elems[(2L * i + 1) * size / (2L * numsamples)];
+        sample->weight = (double)size / numsamples;
+        list_add_elem(rdd->samples, sample);
+    }
+    pthread_mutex_unlock(&(rdd->partitionListLock));
+    free(elems);
+}
+
+// Index of the first element of the sorted "run" that orders after
+// "bound".
+static long upper_bound(RDD *rdd, Vector *run, void *bound) {
+    long lo = 0;
+    long hi = vector_size(run);
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (((Comparator)(rdd->fn))(vector_get(run, mid), bound,
+                                    rdd->ctx) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Whether the next element of sorted input "a" goes before that of "b"
+// while merging; ties keep input partition order.
+static bool merges_first(RDD *rdd, int a, int b, long *pos) {
+    Vector *runA = rdd->shuffle[(size_t)a * rdd->numpartitions];
+    Vector *runB = rdd->shuffle[(size_t)b * rdd->numpartitions];
+    int c = ((Comparator)(rdd->fn))(vector_get(runA, pos[a]),
+                                    vector_get(runB, pos[b]), rdd->ctx);
+    return c < 0 || (c == 0 && a < b);
+}
+
+// Restore the min-heap "heap" of input indexes below position "i".
+static void sift_inputs(RDD *rdd, int *heap, int size, int i, long *pos) {
+    while (1) {
+        int least = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < size && merges_first(rdd, heap[left], heap[least], pos)) {
+            least = left;
+        }
+        if (right < size &&
+            merges_first(rdd, heap[right], heap[least], pos)) {
+            least = right;
+        }
+        if (least == i) {
+            return;
+        }
+        int tmp = heap[i];
+        heap[i] = heap[least];
+        heap[least] = tmp;
+        i = least;
+    }
+}
+
+// Reduce side of a SORTBY: merge the slices of the sorted input
+// partitions that fall in the range of output partition "pnum". The
+// sorted inputs are read by every gather task, and freed once the RDD
+// is computed.
+static void sort_gather(RDD *rdd, int pnum, Vector *out) {
+    int numinputs = rdd->dependencies[0]->numpartitions;
+    long *pos = (long *)malloc(sizeof(long) * (numinputs > 0 ? numinputs : 1));
+    long *end = (long *)malloc(sizeof(long) * (numinputs > 0 ? numinputs : 1));
+    int *heap = (int *)malloc(sizeof(int) * (numinputs > 0 ? numinputs : 1));
+    int size = 0;
+    for (int i = 0; i < numinputs; ++i) {
+        Vector *run = rdd->shuffle[(size_t)i * rdd->numpartitions];
+        pos[i] = pnum == 0               ? 0
+                  : pnum <= rdd->numbounds ? upper_bound(rdd, run,
+                                                         rdd->bounds[pnum - 1])
+                                           : vector_size(run);
+        end[i] = pnum < rdd->numbounds
+                     ? upper_bound(rdd, run, rdd->bounds[pnum])
+                     : vector_size(run);
+        if (pos[i] < end[i]) {
+            heap[size++] = i;
+        }
+    }
+    for (int i = size / 2 - 1; i >= 0; --i) {
+        sift_inputs(rdd, heap, size, i, pos);
+    }
+    while (size > 0) {
+        int i = heap[0];
+        Vector *run = rdd->shuffle[(size_t)i * rdd->numpartitions];
+        vector_append(out, vector_get(run, pos[i]++));
+        if (pos[i] == end[i]) {
+            heap[0] = heap[--size];
+        }
+        sift_inputs(rdd, heap, size, 0, pos);
+    }
+    free(pos);
+    free(end);
+    free(heap);
+}
+
+// Record "out" and "*arena" as the output and the MS_Alloc() arena of
+// the morsel computed by "task". The task that finishes the last morsel
+// of the partition gets the whole partition back, stitched in input
+// order, and all the morsels' arenas in "*arena"; the others get NULL.
+static Vector *stitch_morsels(Task *task, Vector *out, Arena **arena) {
+    Morsels *morsels = task->morsels;
+    morsels->out[task->morsel] = out;
+    morsels->arenas[task->morsel] = *arena;
+    *arena = NULL;
+    pthread_mutex_lock(&(task->rdd->partitionListLock));
+    bool last = ++morsels->numdone == morsels->nummorsels;
+    pthread_mutex_unlock(&(task->rdd->partitionListLock));
+    if (!last) {
+        return NULL;
+    }
+
+    Vector *whole = vector_init();
+    for (int i = 0; i < morsels->nummorsels; ++i) {
+        Vector *part = morsels->out[i];
+        for (long j = 0; j < vector_size(part); ++j) {
+            vector_append(whole, vector_get(part, j));
+        }
+        free_vector(part);
+        if (morsels->arenas[i] == NULL) {
+            continue;
+        }
+        if (*arena == NULL) {
+            *arena = morsels->arenas[i];
+        } else {
+            arena_merge(*arena, morsels->arenas[i]);
+        }
+    }
+    if (morsels->table) {
+        free_hashtable(morsels->table);
+        free(morsels->hashes);
+        free(morsels->hotrows);
+    }
+    if (morsels->hot) {
+        free_hashtable(morsels->hot);
+    }
+    pthread_mutex_destroy(&morsels->buildLock);
+    free(morsels->out);
+    free(morsels->arenas);
+    free(morsels);
+    return whole;
+}
+
+// Compute "topTask" and store its output. Returns false when the
+// partition is not complete yet: another morsel of it is still running,
+// or the other run of a speculated task won.
+static bool run_task(Task *topTask) {
     int partitionIndex = topTask->pnum;
     void *computeFunction = topTask->rdd->fn;
     RDD **dependentRDD = topTask->rdd->dependencies;
-    if (topTask) {
-        // spin until dependencies get computed
-        while (waitDependencies) {
-            waitDependencies = false;
-            for (int i = 0; i < topTask->rdd->numdependencies; i++) {
-                pthread_mutex_lock(&(dependentRDD[i]->partitionListLock));
-                int computed = dependentRDD[i]->numComputed;
-                int total = dependentRDD[i]->numpartitions;
-                pthread_mutex_unlock(&(dependentRDD[i]->partitionListLock));
-
-                if (computed < total) {
-                    waitDependencies = true;
-                }
+    bool complete = true;  // false for all morsels of a partition but one
+    // a take() hands its output over unstored, so it allocates from the
+    // session arena
+    if (topTask->kind != TAKE_TASK) {
+        begin_task_arena();
+    }
+    if (topTask->kind == SHUFFLE_MAP_TASK) {
+        if (topTask->rdd->trans == AGGREGATEBYKEY) {
+            aggregate_map(topTask->rdd, partitionIndex);
+        } else if (topTask->rdd->trans == SORTBY) {
+            sort_map(topTask->rdd, partitionIndex);
+        } else {
+            shuffle_map(topTask->rdd, partitionIndex);
+        }
+        // the buckets go to every output partition, so their memory is
+        // kept with the whole RDD
+        Arena *arena = end_task_arena();
+        if (arena) {
+            pthread_mutex_lock(&(topTask->rdd->partitionListLock));
+            if (topTask->rdd->shared == NULL) {
+                topTask->rdd->shared = arena;
+            } else {
+                arena_merge(topTask->rdd->shared, arena);
             }
+            pthread_mutex_unlock(&(topTask->rdd->partitionListLock));
         }
+    } else {
+        // Tasks are only submitted once the input partitions they read
+        // are stored, see execute() and task_done(). Other partitions
+        // of the same inputs may still be written meanwhile.
 
         // All new results of the partitions[partitionIndex] are stored in this
         // contentList
-        List *contentList = list_init(QUEUE_CAPACITY);
-
-        if (topTask->rdd->trans == MAP) {
-            // There must be only one dependent RDD
-            if (dependentRDD[0]->trans ==
-                FILE_BACKED) {  // partition with a single FilePointer inside
-                while (1) {
-                    void *line = ((Mapper)(computeFunction))(get_nth_elem(
-                        dependentRDD[0]->partitions, partitionIndex));
-                    if (line)
-                        list_add_elem(contentList, line);
-                    else
-                        break;
-                }
-            } else {  // partion with finite regular elements
-                void *line = NULL;
-                List *oldContent = (List *)get_nth_elem(
-                    dependentRDD[0]->partitions, partitionIndex);
-                seek_to_start(oldContent);
-                while ((line = next(oldContent))) {
-                    list_add_elem(contentList,
-                                  ((Mapper)(computeFunction))(line));
-                }
-            }
-        } else if (topTask->rdd->trans == FILTER) {
-            // There must be only one dependent RDD
-            void *line = NULL;
-            List *oldContent = (List *)get_nth_elem(dependentRDD[0]->partitions,
-                                                    partitionIndex);
-            seek_to_start(oldContent);
-            while ((line = next(oldContent))) {
-                if (((Filter)(computeFunction))(line, topTask->rdd->ctx)) {
-                    list_add_elem(contentList, line);
-                }
-            }
+        Vector *contentList = vector_init();
+
+        if (topTask->rdd->trans == SEMIJOIN) {
+            build_bloom(topTask->rdd);
+        }
+        if (topTask->rdd->trans == MAP || topTask->rdd->trans == FILTER ||
+            topTask->rdd->trans == SEMIJOIN) {
+            compute_narrow_stage(topTask, contentList);
+        } else if (topTask->rdd->trans == JOIN && topTask->rdd->keyhash) {
+            compute_hash_join(topTask, contentList);
         } else if (topTask->rdd->trans == JOIN) {
             // There must be two dependent RDDs
-            void *lineA = NULL;
-            void *lineB = NULL;
+            // Stored partitions may be read by several tasks at once, so
+            // index them instead of moving their shared iterator.
             void *newLine = NULL;
-            List *oldContentA = (List *)get_nth_elem(
+            Vector *oldContentA = (Vector *)get_nth_elem(
                 dependentRDD[0]->partitions, partitionIndex);
-            List *oldContentB = (List *)get_nth_elem(
+            Vector *oldContentB = (Vector *)get_nth_elem(
                 dependentRDD[1]->partitions, partitionIndex);
 
-            seek_to_start(oldContentA);
-            while ((lineA = next(oldContentA))) {
-                seek_to_start(oldContentB);
-                while ((lineB = next(oldContentB))) {
+            long lo, hi;
+            morsel_range(topTask, vector_size(oldContentA), &lo, &hi);
+            for (long a = lo; a < hi; a++) {
+                void *lineA = vector_get(oldContentA, a);
+                for (long b = 0; b < vector_size(oldContentB); b++) {
+                    void *lineB = vector_get(oldContentB, b);
                     newLine = ((Joiner)(computeFunction))(lineA, lineB,
                                                           topTask->rdd->ctx);
                     if (newLine) {
-                        list_add_elem(contentList, newLine);
+                        vector_append(contentList, newLine);
                     }
                 }
             }
+        } else if (topTask->rdd->trans == BROADCASTJOIN) {
+            compute_broadcast_join(topTask->rdd, partitionIndex, contentList);
         } else if (topTask->rdd->trans == PARTITIONBY) {
-            // There must be one dependent RDD
-            for (int i = 0; i < dependentRDD[0]->numpartitions; i++) {
-                assert(dependentRDD[0]->partitions != NULL);
-                for (int lineIndex = 0;
-                     lineIndex <
-                     get_size(get_nth_elem(dependentRDD[0]->partitions, i));
-                     lineIndex++) {
-                    int repartitionNum = ((Partitioner)(computeFunction))(
-                        get_nth_elem(
-                            get_nth_elem(dependentRDD[0]->partitions, i),
-                            lineIndex),
-                        topTask->rdd->numpartitions, topTask->rdd->ctx);
-                    if (repartitionNum == partitionIndex) {
-                        list_add_elem(
-                            contentList,
-                            get_nth_elem(
-                                get_nth_elem(dependentRDD[0]->partitions, i),
-                                lineIndex));
-                    }
-                }
-            }
+            gather_shuffle(topTask->rdd, partitionIndex, contentList);
+        } else if (topTask->rdd->trans == AGGREGATEBYKEY) {
+            aggregate_gather(topTask->rdd, partitionIndex, contentList);
+        } else if (topTask->rdd->trans == SORTBY) {
+            sort_gather(topTask->rdd, partitionIndex, contentList);
+        }
+
+        // of two runs of a speculated task, only the first one counts
+        Task *original = topTask->original ? topTask->original : topTask;
+        if (topTask->kind == TAKE_TASK) {
+            // handed over by task_done(), never stored
+            topTask->output = contentList;
+            return true;
+        }
+        Arena *arena = end_task_arena();
+        if (topTask->speculative && atomic_exchange(&original->done, 1)) {
+            free_vector(contentList);
+            free_arena(arena);
+            contentList = NULL;
+            complete = false;
+        }
+        if (topTask->morsels && complete) {
+            contentList = stitch_morsels(topTask, contentList, &arena);
+            complete = contentList != NULL;
         }
 
         // update the result partitions for this RDD
-        pthread_mutex_lock(&(topTask->rdd->partitionListLock));
-        if (topTask->rdd->partitions == NULL)
-            topTask->rdd->partitions = list_init(topTask->rdd->numpartitions);
-        if (get_size(contentList)) {  // To handle root node (FILE_BACKED)
+        if (complete) {
+            pthread_mutex_lock(&(topTask->rdd->partitionListLock));
             list_insert_at(topTask->rdd->partitions, contentList,
                            partitionIndex);
+            topTask->rdd->arenas[partitionIndex] = arena;
+            pthread_mutex_unlock(&(topTask->rdd->partitionListLock));
         }
-        topTask->rdd->numComputed++;
-        pthread_mutex_unlock(&(topTask->rdd->partitionListLock));
     }
+    return complete;
+}
+
+static void do_computation(Task *topTask) {
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool complete = run_task(topTask);
     clock_gettime(CLOCK_MONOTONIC, &end);
     topTask->metric->duration = TIME_DIFF_MICROS(start, end);
+    record_task_time(topTask);
+    if (complete) {
+        task_done(topTask);
+    }
     pthread_mutex_lock(&metric_queue->queue_lock);
     while (metric_queue->queue->size == METRIC_QUEUE_CAPACITY) {
         pthread_cond_wait(&metric_queue->queue_not_full,
@@ -172,36 +805,324 @@ static void do_computation(Task *topTask) {
     pthread_mutex_unlock(&metric_queue->queue_lock);
 }
 
-void *consumer(void *arg) {
+// Drop one reference to "job", freeing it with the last one.
+static void release_job(Job *job) {
+    if (atomic_fetch_sub(&job->refs, 1) != 1) {
+        return;
+    }
+    for (int i = 0; job->queues && i < pool.num_thread; ++i) {
+        free_pqueue(job->queues[i]);
+    }
+    free(job->queues);
+    free(job);
+}
+
+// Steal a task of "job" from the workers of our own NUMA node first:
+// their queues hold tasks whose inputs they just produced, still in
+// memory local to us.
+static Task *steal_task(Worker *self, Job *job) {
+    int victim = rand_r(&self->seed) % pool.num_thread;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < pool.num_thread; ++i) {
+            Worker *w = &pool.workers[(victim + i) % pool.num_thread];
+            if (w == self || (w->node == self->node) != (pass == 0)) {
+                continue;
+            }
+            Task *task = (Task *)pqueue_steal(job->queues[w->id]);
+            if (task) {
+                return task;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Take a task of the job with the least worker time per unit of weight
+// that has any queued, from our own queue of it first. Falls back to
+// the other jobs in the same order when the tasks were taken meanwhile.
+static Task *take_task(Worker *self) {
+    pthread_rwlock_rdlock(&pool.jobs_lock);
+    int numjobs = 0;
+    Job *order[pool.num_jobs + 1];
+    long vruntimes[pool.num_jobs + 1];
+    for (int i = 0; i < pool.num_jobs; ++i) {
+        Job *job = pool.jobs[i];
+        if (atomic_load(&job->numQueued) == 0) {
+            continue;
+        }
+        long vruntime = atomic_load(&job->vruntime);
+        int j = numjobs++;
+        for (; j > 0 && vruntimes[j - 1] > vruntime; --j) {
+            order[j] = order[j - 1];
+            vruntimes[j] = vruntimes[j - 1];
+        }
+        order[j] = job;
+        vruntimes[j] = vruntime;
+    }
+
+    Task *task = NULL;
+    for (int i = 0; i < numjobs && task == NULL; ++i) {
+        task = (Task *)pqueue_pop(order[i]->queues[self->id]);
+        if (task == NULL) {
+            task = steal_task(self, order[i]);
+        }
+    }
+    pthread_rwlock_unlock(&pool.jobs_lock);
+
+    if (task) {
+        atomic_fetch_sub(&task->job->numQueued, 1);
+    }
+    return task;
+}
+
+// Look for a speculative task that runs far longer than its siblings and
+// return a copy of it for "self" to run, or NULL.
+static Task *copy_straggler(Worker *self) {
+    if (atomic_load(&pool.num_watched) == 0) {
+        return NULL;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    Task *copy = NULL;
+    pthread_mutex_lock(&pool.spec_lock);
+    for (int i = 0; i < pool.num_thread && copy == NULL; ++i) {
+        Task *task = pool.workers[i].running;
+        if (&pool.workers[i] == self || task == NULL ||
+            task->original != NULL || atomic_load(&task->copied) ||
+            atomic_load(&task->done) ||
+            !is_straggler(task, TIME_DIFF_MICROS(task->metric->scheduled,
+                                                 now))) {
+            continue;
+        }
+        atomic_store(&task->copied, 1);
+        // the copy reads the original's `done` until it has finished
+        atomic_fetch_add(&task->refs, 1);
+        copy = thread_pool_new_task();
+        copy->rdd = task->rdd;
+        copy->pnum = task->pnum;
+        copy->kind = task->kind;
+        copy->morsels = task->morsels;
+        copy->morsel = task->morsel;
+        copy->priority = task->priority;
+        copy->speculative = 1;
+        atomic_init(&copy->copied, 0);
+        atomic_init(&copy->done, 0);
+        copy->original = task;
+        copy->job = task->job;
+        copy->cancel = task->cancel;
+        copy->take = NULL;
+        copy->output = NULL;
+        copy->metric->rdd = task->rdd;
+        copy->metric->pnum = task->pnum;
+        copy->metric->created = now;
+    }
+    pthread_mutex_unlock(&pool.spec_lock);
+
+    if (copy) {
+        atomic_fetch_add(&copy->job->refs, 1);
+        atomic_fetch_add(&pool.num_outstanding, 1);
+    }
+    return copy;
+}
+
+static void set_running(Worker *self, Task *task) {
+    pthread_mutex_lock(&pool.spec_lock);
+    self->running = task;
+    pthread_mutex_unlock(&pool.spec_lock);
+}
+
+// Take a queued task, else copy a straggler; park when every queue is
+// empty. Returns NULL once the pool is shutting down and no task is left.
+static Task *next_task(Worker *self) {
     while (1) {
+        Task *task = take_task(self);
+        if (task) {
+            atomic_fetch_sub(&pool.num_queued, 1);
+            return task;
+        }
+        task = copy_straggler(self);
+        if (task) {
+            return task;
+        }
+
+        // A submitter bumps num_queued before reading num_sleeping, and
+        // we bump num_sleeping before reading num_queued, so at least
+        // one side sees the other and the wakeup cannot be lost.
         pthread_mutex_lock(&pool.queue_lock);
-        while (pool.num_task == 0) {
-            pthread_cond_wait(&pool.queue_not_empty, &pool.queue_lock);
+        atomic_fetch_add(&pool.num_sleeping, 1);
+        while (atomic_load(&pool.num_queued) == 0 && !pool.shutdown) {
+            if (atomic_load(&pool.num_watched) == 0) {
+                pthread_cond_wait(&pool.queue_not_empty, &pool.queue_lock);
+                continue;
+            }
+            // stragglers show up without anything being queued
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += SPECULATION_INTERVAL_USEC * 1000L;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_sec += 1;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&pool.queue_not_empty, &pool.queue_lock,
+                                   &until);
+            break;
         }
-        Task *task = (Task *)list_remove_front(pool.task_queue);
-        --pool.num_task;
-        pthread_cond_signal(&pool.queue_not_full);
+        atomic_fetch_sub(&pool.num_sleeping, 1);
+        bool shutdown = pool.shutdown && atomic_load(&pool.num_queued) == 0;
         pthread_mutex_unlock(&pool.queue_lock);
-        if (task->rdd == NULL) {
+        if (shutdown) {
+            return NULL;
+        }
+    }
+}
+
+void *consumer(void *arg) {
+    current_worker = (Worker *)arg;
+    while (1) {
+        Task *task = next_task(current_worker);
+        if (task == NULL) {
             break;
         }
         clock_gettime(CLOCK_MONOTONIC, &task->metric->scheduled);
-        do_computation(task);
+        if (task->speculative && task->original == NULL) {
+            set_running(current_worker, task);
+            // have an idle worker keep an eye on it
+            if (atomic_fetch_add(&pool.num_watched, 1) == 0 &&
+                atomic_load(&pool.num_sleeping) > 0) {
+                pthread_mutex_lock(&pool.queue_lock);
+                pthread_cond_signal(&pool.queue_not_empty);
+                pthread_mutex_unlock(&pool.queue_lock);
+            }
+            do_computation(task);
+            atomic_fetch_sub(&pool.num_watched, 1);
+            set_running(current_worker, NULL);
+        } else {
+            do_computation(task);
+        }
+
+        Job *job = task->job;
+        long duration = (long)task->metric->duration;
+        atomic_fetch_add(&job->numTasks, 1);
+        atomic_fetch_add(&job->taskTime, duration);
+        // even tasks below a microsecond use up some of the job's share
+        atomic_fetch_add(&job->vruntime,
+                         (duration + 1) * VRUNTIME_SCALE / job->weight);
+        release_job(job);
+        if (task->original) {
+            thread_pool_release_task(task->original);
+        }
+        thread_pool_release_task(task);
+
+        // Tasks unblocked by this one were submitted inside
+        // do_computation(), so the counter cannot drop to zero early.
+        if (atomic_fetch_sub(&pool.num_outstanding, 1) == 1) {
+            pthread_mutex_lock(&pool.queue_lock);
+            pthread_cond_broadcast(&pool.all_done);
+            pthread_mutex_unlock(&pool.queue_lock);
+        }
     }
     return NULL;
 }
 
+// NUMA node of "cpu" as reported by sysfs, or 0 if it does not say.
+static int cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return 0;
+    }
+    int node = 0;
+    struct dirent *entry = NULL;
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1) {
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+// Give worker i the i-th CPU we are allowed to run on. Their output
+// partitions are allocated and first touched by the workers themselves,
+// so pinned workers keep them in memory of their own NUMA node.
+static void assign_cpus(int numthreads) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == -1) {
+        perror("sched_getaffinity");
+        exit(EXIT_FAILURE);
+    }
+
+    int cpu = -1;
+    for (int i = 0; i < numthreads; i++) {
+        do {
+            cpu = (cpu + 1) % CPU_SETSIZE;
+        } while (!CPU_ISSET(cpu, &set));
+        pool.workers[i].cpu = cpu;
+        pool.workers[i].node = cpu_node(cpu);
+    }
+}
+
+static int start_worker(Worker *w) {
+    if (w->cpu < 0) {
+        return pthread_create(&w->thread, NULL, consumer, w);
+    }
+
+    // pinned from the start, so even the stack is first touched locally
+    pthread_attr_t attr;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_attr_init(&attr);
+    pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    int err = pthread_create(&w->thread, &attr, consumer, w);
+    pthread_attr_destroy(&attr);
+    if (err == EINVAL) {
+        // the CPU went away since we read the affinity mask
+        w->cpu = -1;
+        w->node = 0;
+        err = pthread_create(&w->thread, NULL, consumer, w);
+    }
+    return err;
+}
+
 void thread_pool_init(int numthreads) {
-    pool.threads = (pthread_t *)malloc(sizeof(pthread_t) * numthreads);
+    pool.workers = (Worker *)malloc(sizeof(Worker) * numthreads);
     pool.num_thread = numthreads;
-    pool.task_queue = list_init(QUEUE_CAPACITY);
-    pool.num_task = 0;
+    atomic_init(&pool.next_victim, 0);
+    atomic_init(&pool.num_queued, 0);
+    atomic_init(&pool.num_sleeping, 0);
+    atomic_init(&pool.num_outstanding, 0);
+    atomic_init(&pool.num_watched, 0);
+    pool.shutdown = false;
+    pthread_mutex_init(&pool.spec_lock, NULL);
+    pool.tasks = freelist_init(sizeof(Task));
+    pool.jobs = (Job **)malloc(sizeof(Job *) * JOBS_INIT_CAPACITY);
+    pool.num_jobs = 0;
+    pool.jobs_capacity = JOBS_INIT_CAPACITY;
+    pthread_rwlock_init(&pool.jobs_lock, NULL);
     pthread_mutex_init(&pool.queue_lock, NULL);
     pthread_cond_init(&pool.queue_not_empty, NULL);
-    pthread_cond_init(&pool.queue_not_full, NULL);
+    pthread_cond_init(&pool.all_done, NULL);
     for (int i = 0; i < numthreads; i++) {
-        if (pthread_create(&(pool.threads[i]), NULL, consumer, NULL) != 0) {
+        pool.workers[i].id = i;
+        pool.workers[i].seed = (unsigned int)i + 1;
+        pool.workers[i].cpu = -1;
+        pool.workers[i].node = 0;
+        pool.workers[i].running = NULL;
+        pool.workers[i].tasks.head = NULL;
+        pool.workers[i].tasks.count = 0;
+    }
+    const char *pin = getenv(PIN_WORKERS_ENV);
+    if (pin && strcmp(pin, "") != 0 && strcmp(pin, "0") != 0) {
+        assign_cpus(numthreads);
+    }
+    for (int i = 0; i < numthreads; i++) {
+        if (start_worker(&pool.workers[i]) != 0) {
             perror("pthread_create");
+            pool.num_thread = i;
             thread_pool_destroy();
             exit(EXIT_FAILURE);
         }
@@ -209,33 +1130,139 @@ void thread_pool_init(int numthreads) {
 }
 
 void thread_pool_destroy() {
-    free(pool.threads);
+    thread_pool_wait();
+
+    pthread_mutex_lock(&pool.queue_lock);
+    pool.shutdown = true;
+    pthread_cond_broadcast(&pool.queue_not_empty);
+    pthread_mutex_unlock(&pool.queue_lock);
+    for (int i = 0; i < pool.num_thread; ++i) {
+        pthread_join(pool.workers[i].thread, NULL);
+    }
+
+    // jobs never waited for are done by now, but still registered
+    for (int i = 0; i < pool.num_jobs; ++i) {
+        release_job(pool.jobs[i]);
+    }
+    free(pool.jobs);
+    free(pool.workers);
+    free_freelist(pool.tasks);
+    pthread_rwlock_destroy(&pool.jobs_lock);
     pthread_mutex_destroy(&pool.queue_lock);
+    pthread_mutex_destroy(&pool.spec_lock);
     pthread_cond_destroy(&pool.queue_not_empty);
-    pthread_cond_destroy(&pool.queue_not_full);
+    pthread_cond_destroy(&pool.all_done);
 }
 
+// Completion barrier for every job submitted so far. The workers stay
+// parked afterwards so later jobs in the session can reuse them.
 void thread_pool_wait() {
-    for (int i = 0; i < pool.num_thread; ++i) {
-        Task *task = (Task *)malloc(sizeof(Task));
-        task->rdd = NULL;
-        thread_pool_submit(task);
-    }
-    for (int i = 0; i < pool.num_thread; ++i) {
-        pthread_join(pool.threads[i], NULL);
+    pthread_mutex_lock(&pool.queue_lock);
+    while (atomic_load(&pool.num_outstanding) > 0) {
+        pthread_cond_wait(&pool.all_done, &pool.queue_lock);
     }
+    pthread_mutex_unlock(&pool.queue_lock);
 }
 
 void thread_pool_submit(Task *task) {
     if (!task) {
         return;
     }
-    pthread_mutex_lock(&pool.queue_lock);
-    while (pool.num_task == QUEUE_CAPACITY) {
-        pthread_cond_wait(&pool.queue_not_full, &pool.queue_lock);
+    atomic_fetch_add(&pool.num_outstanding, 1);
+    atomic_fetch_add(&task->job->refs, 1);
+
+    // Workers keep what they spawn or unblock; the driver spreads its
+    // tasks over all queues of the job. Queues grow on demand, so a
+    // worker never blocks here on the tasks it unblocks. Owners and
+    // thieves both take the task with the longest critical path first.
+    Worker *target = current_worker;
+    if (target == NULL) {
+        unsigned int victim = atomic_fetch_add(&pool.next_victim, 1);
+        target = &pool.workers[victim % pool.num_thread];
     }
-    list_add_elem(pool.task_queue, task);
-    ++pool.num_task;
-    pthread_cond_signal(&pool.queue_not_empty);
-    pthread_mutex_unlock(&pool.queue_lock);
+    atomic_fetch_add(&task->job->numQueued, 1);
+    pqueue_push(task->job->queues[target->id], task, task->priority);
+
+    atomic_fetch_add(&pool.num_queued, 1);
+    if (atomic_load(&pool.num_sleeping) > 0) {
+        pthread_mutex_lock(&pool.queue_lock);
+        pthread_cond_signal(&pool.queue_not_empty);
+        pthread_mutex_unlock(&pool.queue_lock);
+    }
+}
+
+Task *thread_pool_new_task() {
+    Task *task = (Task *)freelist_get(
+        pool.tasks, current_worker ? &current_worker->tasks : NULL);
+    task->metric = &task->slot;
+    task->slot.task = task;
+    atomic_init(&task->refs, 2);
+    return task;
+}
+
+void thread_pool_release_task(Task *task) {
+    if (atomic_fetch_sub(&task->refs, 1) == 1) {
+        freelist_put(pool.tasks,
+                     current_worker ? &current_worker->tasks : NULL, task);
+    }
+}
+
+void thread_pool_run_inline(Task *task) {
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_task(task);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    task->metric->duration = TIME_DIFF_MICROS(start, end);
+    record_task_time(task);
+}
+
+void thread_pool_add_job(Job *job) {
+    job->queues =
+        (PriorityQueue **)malloc(sizeof(PriorityQueue *) * pool.num_thread);
+    for (int i = 0; i < pool.num_thread; ++i) {
+        job->queues[i] = pqueue_init(PQUEUE_INIT_CAPACITY);
+    }
+
+    pthread_rwlock_wrlock(&pool.jobs_lock);
+    long vruntime = 0;
+    for (int i = 0; i < pool.num_jobs; ++i) {
+        long other = atomic_load(&pool.jobs[i]->vruntime);
+        if (i == 0 || other < vruntime) {
+            vruntime = other;
+        }
+    }
+    atomic_store(&job->vruntime, vruntime);
+    if (pool.num_jobs == pool.jobs_capacity) {
+        pool.jobs_capacity *= 2;
+        pool.jobs = (Job **)realloc(pool.jobs,
+                                    sizeof(Job *) * pool.jobs_capacity);
+        if (pool.jobs == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pool.jobs[pool.num_jobs++] = job;
+    pthread_rwlock_unlock(&pool.jobs_lock);
+}
+
+void thread_pool_init_job(Job *job) {
+    job->queues = NULL;
+    atomic_init(&job->vruntime, 0);
+    atomic_init(&job->numQueued, 0);
+    atomic_init(&job->numTasks, 0);
+    atomic_init(&job->taskTime, 0);
+    atomic_init(&job->refs, 1);
+}
+
+void thread_pool_remove_job(Job *job) {
+    pthread_rwlock_wrlock(&pool.jobs_lock);
+    for (int i = 0; i < pool.num_jobs; ++i) {
+        if (pool.jobs[i] == job) {
+            pool.jobs[i] = pool.jobs[--pool.num_jobs];
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&pool.jobs_lock);
+    release_job(job);
 }
@@ -3,6 +3,9 @@
 
 #include "minispark.h"
 
+// Set to anything but "0" to pin worker i to the i-th allowed CPU
+#define PIN_WORKERS_ENV "MINISPARK_PIN_WORKERS"
+
 int get_num_threads(void);
 
 void thread_pool_init(int numthreads);
@@ -13,4 +16,33 @@ void thread_pool_wait(void);
 
 void thread_pool_submit(Task* task);
 
+// Take a task, with "metric" pointing to its slot, from the pool's free
+// list; workers take from a cache of their own. It goes back once the
+// run has finished and the metric thread has logged it, see
+// thread_pool_release_task().
+Task* thread_pool_new_task(void);
+
+// Drop one reference to a task taken with thread_pool_new_task(),
+// returning it to the free list with the last one.
+void thread_pool_release_task(Task* task);
+
+// Compute "task" on the calling thread and store its output, bypassing
+// the queues, task_done() and the metric log. Its run time is still
+// recorded. The task must not be speculative or a morsel.
+void thread_pool_run_inline(Task* task);
+
+// Set up the accounting of a new job, holding the handle's reference.
+void thread_pool_init_job(Job* job);
+
+// Give "job" a queue on every worker and let the workers pick its tasks.
+// It starts at the least worker time of the jobs already running, so it
+// neither starves them nor is starved by them. Jobs computed without
+// the workers are never added.
+void thread_pool_add_job(Job* job);
+
+// Stop scheduling "job", if it was added, and drop the handle's
+// reference. The job is freed once its last task, e.g. the losing run
+// of a speculated one, has finished.
+void thread_pool_remove_job(Job* job);
+
 #endif  // !__THREAD_POOL_H__
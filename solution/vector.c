@@ -0,0 +1,58 @@
+#include "vector.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+Vector* vector_init() {
+    Vector* v = (Vector*)calloc(1, sizeof(Vector));
+    if (v == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    return v;
+}
+
+void vector_append(Vector* v, void* elem) {
+    if (v->end == v->limit) {
+        int k = 0;
+        while (k < VECTOR_MAX_CHUNKS && v->chunks[k] != NULL) {
+            ++k;
+        }
+        if (k == VECTOR_MAX_CHUNKS) {
+            fprintf(stderr, "vector_append: vector is full\n");
+            exit(EXIT_FAILURE);
+        }
+        long capacity = 1L << (k + VECTOR_FIRST_SHIFT);
+        v->chunks[k] = (void**)malloc(sizeof(void*) * capacity);
+        if (v->chunks[k] == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        v->end = v->chunks[k];
+        v->limit = v->chunks[k] + capacity;
+    }
+    *v->end++ = elem;
+    ++v->size;
+}
+
+long vector_size(Vector* v) {
+    return v->size;
+}
+
+void vector_clear(Vector* v) {
+    for (int k = 0; k < VECTOR_MAX_CHUNKS && v->chunks[k] != NULL; ++k) {
+        free(v->chunks[k]);
+        v->chunks[k] = NULL;
+    }
+    v->size = 0;
+    v->end = NULL;
+    v->limit = NULL;
+}
+
+void free_vector(Vector* v) {
+    if (v == NULL) {
+        return;
+    }
+    vector_clear(v);
+    free(v);
+}
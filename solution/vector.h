@@ -0,0 +1,87 @@
+/**
+ * @file vector.h
+ * @author
+ * @brief Definition of an append-only vector stored in chunks
+ * @version 0.1
+ * @date 2025-04-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef __VECTOR_H__
+#define __VECTOR_H__
+
+#define VECTOR_FIRST_SHIFT 4  // the first chunk holds 1 << this elements
+#define VECTOR_MAX_CHUNKS 40
+
+/**
+ * @brief Append-only generic vector, used to store partitions.
+ *
+ * Chunk k holds twice as many elements as chunk k - 1, and chunks are
+ * allocated as the vector reaches them. Growing never moves an element,
+ * an element's chunk and offset follow from its index with a few bit
+ * operations, and consecutive elements are contiguous within a chunk.
+ */
+typedef struct Vector {
+    long size;                         /**< Number of elements */
+    void** end;    /**< Where the next element goes in the last chunk */
+    void** limit;  /**< End of the last chunk, NULL before the first */
+    void** chunks[VECTOR_MAX_CHUNKS];  /**< The chunks allocated so far */
+} Vector;
+
+/**
+ * @brief Initialize an empty vector. No chunk is allocated until the
+ * first element is appended.
+ *
+ * @return Vector* Pointer to the newly created vector.
+ */
+Vector* vector_init() __attribute__((warn_unused_result));
+
+/**
+ * @brief Append an element at the end of the vector.
+ *
+ * @param v Pointer to the vector.
+ * @param elem Generic pointer to the element to append.
+ */
+void vector_append(Vector* v, void* elem);
+
+/**
+ * @brief Get the element at a given index.
+ *
+ * Inlined, as every stage reads its input partitions through it.
+ *
+ * @param v Pointer to the vector.
+ * @param i Index, below the vector's size.
+ * @return void* The element.
+ */
+static inline void* vector_get(Vector* v, long i) {
+    // chunk k starts at index ((1 << k) - 1) << VECTOR_FIRST_SHIFT
+    unsigned long j = ((unsigned long)i >> VECTOR_FIRST_SHIFT) + 1;
+    int k = (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl(j);
+    return v->chunks[k][i - (((1L << k) - 1) << VECTOR_FIRST_SHIFT)];
+}
+
+/**
+ * @brief Get the number of elements of the vector.
+ *
+ * @param v Pointer to the vector.
+ * @return long The number of elements.
+ */
+long vector_size(Vector* v);
+
+/**
+ * @brief Remove every element, freeing the chunks but not the elements.
+ * The vector can be appended to again.
+ *
+ * @param v Pointer to the vector.
+ */
+void vector_clear(Vector* v);
+
+/**
+ * @brief Free the vector and its chunks, but not the elements.
+ *
+ * @param v Pointer to the vector to free, or NULL.
+ */
+void free_vector(Vector* v);
+
+#endif  // !__VECTOR_H__
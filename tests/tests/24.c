@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include "lib.h"
+#include "minispark.h"
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("need at least one file\n");
+    return -1;
+  }
+
+  MS_Run();
+  RDD* files = RDDFromFiles(argv + 1, argc - 1);
+  RDD* lines = map(files, GetLines);
+
+  // several actions in the same session share one thread pool
+  printf("lines: %ld\n", count(lines));
+  printf("matches: %ld\n", count(filter(map(files, GetLines), StringContains, "one")));
+  print(lines, StringPrinter);
+  printf("lines again: %ld\n", count(lines));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
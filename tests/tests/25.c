@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 8
+#define FILENAMESIZE 100
+
+// order-independent checksum of every printed row
+unsigned long checksum = 0;
+int rows = 0;
+
+void ChecksumPrinter(void* arg) {
+  struct row* data = (struct row*)arg;
+  unsigned long hash = 5381;
+  for (int i = 0; i < data->ncols; i++) {
+    char* c = data->cols[i];
+    while (*c) hash = hash * 33 + *c++;
+  }
+  checksum += hash;
+  rows++;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(FILENAMESIZE, 1);
+    sprintf(filenames[i], "./test_files/largevals%d.txt", i);
+  }
+
+  MS_Run();
+
+  // self-join, so every key finds exactly one match
+  RDD* left = partitionBy(map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols), ColumnHashPartitioner, 4, &pctx);
+  RDD* right = partitionBy(map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols), ColumnHashPartitioner, 4, &pctx);
+
+  print(join(left, right, SumJoin, &sctx), ChecksumPrinter);
+  unsigned long nested = checksum;
+  int nestedrows = rows;
+
+  checksum = 0;
+  rows = 0;
+  print(hashJoin(left, right, SumJoin, SumJoinKeyHash, &sctx), ChecksumPrinter);
+
+  MS_TearDown();
+
+  printf("rows: %d\n", rows);
+  if (rows == nestedrows && checksum == nested)
+    printf("hash join matches nested-loop join\n");
+  else
+    printf("mismatch: nested-loop %d rows %lu, hash %d rows %lu\n",
+           nestedrows, nested, rows, checksum);
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+// The input holds the numbers 0..n-1, one per line. Both RDDs below are
+// big enough to be computed as several morsels, which must be stitched
+// back in input order.
+long expected = 0;
+long misplaced = 0;
+
+// Number of tasks logged for partition 0 of "rdd" in the metric log,
+// which is complete once MS_TearDown() returns.
+int LoggedTasks(RDD* rdd) {
+  char prefix[64];
+  char line[256];
+  int tasks = 0;
+  snprintf(prefix, sizeof(prefix), "RDD %p Part 0 ", (void*)rdd);
+  FILE* fp = fopen("metrics.log", "r");
+  if (fp == NULL) {
+    perror("fopen");
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), fp)) {
+    if (strncmp(line, prefix, strlen(prefix)) == 0)
+      tasks++;
+  }
+  fclose(fp);
+  return tasks;
+}
+
+void OrderPrinter(void* arg) {
+  if (atol((char*)arg) != expected)
+    misplaced++;
+  expected++;
+}
+
+void EvenOrderPrinter(void* arg) {
+  if (atol((char*)arg) != expected)
+    misplaced++;
+  expected += 2;
+}
+
+unsigned long FirstPartition(void* arg, int numpartitions, void* ctx) {
+  (void)arg;
+  (void)numpartitions;
+  (void)ctx;
+  return 0;
+}
+
+int IsEven(void* arg, void* ctx) {
+  (void)ctx;
+  return atol((char*)arg) % 2 == 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    printf("usage: %s <file of numbered lines>\n", argv[0]);
+    return 1;
+  }
+
+  MS_Run();
+
+  // one big text file, read as several byte ranges
+  RDD* lines = map(RDDFromTextFiles(&argv[1], 1), GetLines);
+  print(lines, OrderPrinter);
+  printf("lines: %ld, misplaced: %ld\n", expected, misplaced);
+
+  // one hot partition, filtered as several index ranges
+  expected = 0;
+  misplaced = 0;
+  RDD* even = filter(partitionBy(lines, FirstPartition, 1, NULL), IsEven, NULL);
+  print(even, EvenOrderPrinter);
+  printf("even lines: %ld, misplaced: %ld\n", count(even), misplaced);
+
+  MS_TearDown();
+
+  // unsplit, the hot partition would have been filtered by a single task
+  printf("hot partition split: %s\n", LoggedTasks(even) > 1 ? "yes" : "no");
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+  return 0;
+}
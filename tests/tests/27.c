@@ -0,0 +1,103 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 8
+#define FILENAMESIZE 100
+
+// set by any task that ran on a worker allowed on more than one CPU
+atomic_int unpinned = 0;
+
+void* CheckPinned(void* arg) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == -1 || CPU_COUNT(&set) != 1)
+    atomic_store(&unpinned, 1);
+  return arg;
+}
+
+// CPUs the workers that ran a MeetOtherWorkers() task were pinned to
+cpu_set_t seen;
+pthread_mutex_t seenLock = PTHREAD_MUTEX_INITIALIZER;
+atomic_int waits = 0;
+
+int SeenCPUs() {
+  pthread_mutex_lock(&seenLock);
+  int n = CPU_COUNT(&seen);
+  pthread_mutex_unlock(&seenLock);
+  return n;
+}
+
+// Record the CPU of this worker, then hold it for up to a second until
+// another worker, pinned elsewhere, records its own: the held worker
+// cannot take the other partitions meanwhile. At most NUMFILES rows
+// wait, so a failing run still ends.
+void* MeetOtherWorkers(void* arg) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) == 1) {
+    pthread_mutex_lock(&seenLock);
+    CPU_OR(&seen, &seen, &set);
+    pthread_mutex_unlock(&seenLock);
+  }
+  if (SeenCPUs() < 2 && atomic_fetch_add(&waits, 1) < NUMFILES) {
+    struct timespec req = {.tv_sec = 0, .tv_nsec = 10 * 1000 * 1000};
+    for (int i = 0; i < 100 && SeenCPUs() < 2; i++) {
+      nanosleep(&req, NULL);
+    }
+  }
+  return arg;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(FILENAMESIZE, 1);
+    sprintf(filenames[i], "./test_files/largevals%d.txt", i);
+  }
+
+  MS_Run();
+
+  RDD* rows = map(map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols), CheckPinned);
+  RDD* parts = partitionBy(rows, ColumnHashPartitioner, 4, &pctx);
+  printf("rows: %ld\n", count(rows));
+  printf("joined: %ld\n", count(hashJoin(parts, parts, SumJoin, SumJoinKeyHash, &sctx)));
+  printf("workers pinned: %s\n", atomic_load(&unpinned) ? "no" : "yes");
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+    perror("sched_getaffinity");
+    exit(1);
+  }
+  if (CPU_COUNT(&allowed) > 1) {
+    CPU_ZERO(&seen);
+    count(map(map(RDDFromFiles(filenames, NUMFILES), GetLines),
+              MeetOtherWorkers));
+    printf("workers on different CPUs: %s\n", SeenCPUs() > 1 ? "yes" : "no");
+  } else {
+    // skipped: every worker is pinned to the only CPU we may use
+    printf("workers on different CPUs: yes\n");
+  }
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 8
+#define FILENAMESIZE 100
+
+// The first run over the first row of the first file stalls until a
+// second run reaches the same row, or for ten seconds: a straggler that
+// only a speculative copy overtakes.
+int cpu_cnt = 0;
+atomic_int runs = 0;
+
+void* StallOnce(void* arg) {
+  struct row* row = (struct row*)arg;
+  if (strcmp(row->cols[0], "227010") != 0)
+    return arg;
+  // with a single worker there is nobody to run the copy
+  if (atomic_fetch_add(&runs, 1) == 0 && cpu_cnt > 1) {
+    struct timespec req = {.tv_sec = 0, .tv_nsec = 10 * 1000 * 1000};
+    for (int i = 0; i < 1000 && atomic_load(&runs) < 2; i++)
+      nanosleep(&req, NULL);
+  }
+  return arg;
+}
+
+unsigned long FirstColumnPartitioner(void* arg, int numpartitions, void* ctx) {
+  (void)ctx;
+  struct row* row = (struct row*)arg;
+  return atoi(row->cols[0]) % numpartitions;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == -1) {
+    perror("sched_getaffinity");
+    exit(1);
+  }
+  cpu_cnt = CPU_COUNT(&set);
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(FILENAMESIZE, 1);
+    sprintf(filenames[i], "./test_files/largevals%d.txt", i);
+  }
+
+  MS_Run();
+
+  RDD* rows = partitionBy(map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols), FirstColumnPartitioner, 8, NULL);
+  printf("rows: %ld\n", count(rows));
+
+  printf("stalled rows: %ld\n", count(speculate(map(rows, StallOnce))));
+
+  MS_TearDown();
+
+  if (cpu_cnt < 2) {
+    // skipped: a single worker cannot run a copy
+    printf("straggler speculated: yes\n");
+  } else {
+    printf("straggler speculated: %s\n",
+           atomic_load(&runs) > 1 ? "yes" : "no");
+  }
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 8
+#define FILENAMESIZE 100
+#define NUMQUERIES 4
+
+// Several application threads run actions at the same time over DAGs
+// sharing the same input files and one intermediate RDD.
+RDD* files;
+RDD* shared;
+int sharedRows[NUMQUERIES];
+int ownRows[NUMQUERIES];
+int joinedRows[NUMQUERIES];
+
+void* Query(void* arg) {
+  long id = (long)arg;
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  RDD* rows = map(map(files, GetLines), SplitCols);
+  RDD* parts = partitionBy(rows, ColumnHashPartitioner, 4, &pctx);
+  sharedRows[id] = count(shared);
+  ownRows[id] = count(rows);
+  joinedRows[id] = count(hashJoin(parts, parts, SumJoin, SumJoinKeyHash, &sctx));
+  return NULL;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  pthread_t threads[NUMQUERIES];
+  struct colpart_ctx pctx = {0};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(FILENAMESIZE, 1);
+    sprintf(filenames[i], "./test_files/largevals%d.txt", i);
+  }
+
+  MS_Run();
+
+  files = RDDFromFiles(filenames, NUMFILES);
+  shared = partitionBy(map(map(files, GetLines), SplitCols), ColumnHashPartitioner, 8, &pctx);
+  for (long i = 0; i < NUMQUERIES; i++) {
+    pthread_create(&threads[i], NULL, Query, (void*)i);
+  }
+  for (int i = 0; i < NUMQUERIES; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  for (int i = 0; i < NUMQUERIES; i++) {
+    printf("query %d: shared %d, rows %d, joined %d\n", i, sharedRows[i], ownRows[i], joinedRows[i]);
+  }
+
+  // two jobs of different weights, waited for in the other order
+  RDD* heavy = map(map(files, GetLines), SplitCols);
+  RDD* light = map(map(files, GetLines), SplitCols);
+  Job* heavyJob = MS_JobSubmit(heavy, 4);
+  Job* lightJob = MS_JobSubmit(light, 1);
+  MS_JobWait(lightJob);
+  MS_JobWait(heavyJob);
+  printf("heavy: %ld, light: %ld\n", count(heavy), count(light));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 8
+#define FILENAMESIZE 100
+
+// The driver builds and launches the next DAG while the previous one
+// runs, and combines the results of several actions.
+atomic_int total = 0;
+atomic_int callbacks = 0;
+
+int KeyIs(void* arg, void* key) {
+  return strcmp(((struct row*)arg)->cols[0], (char*)key) == 0;
+}
+
+void AddResult(long result, void* arg) {
+  atomic_fetch_add(&total, result);
+  atomic_fetch_add((atomic_int*)arg, 1);
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(FILENAMESIZE, 1);
+    sprintf(filenames[i], "./test_files/largevals%d.txt", i);
+  }
+
+  MS_Run();
+
+  RDD* rows = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols);
+  Future* rowsCount = count_async(rows);
+  future_then(rowsCount, AddResult, &callbacks);
+
+  // built while the rows are being read
+  RDD* parts = partitionBy(rows, ColumnHashPartitioner, 4, &pctx);
+  Future* joinedCount = count_async(hashJoin(parts, parts, SumJoin, SumJoinKeyHash, &sctx));
+  future_then(joinedCount, AddResult, &callbacks);
+
+  RDD* none = filter(rows, KeyIs, "no such key");
+  Future* noneCount = count_async(none);
+  while (!future_poll(noneCount))
+    usleep(1000);
+  // already complete: called right away
+  future_then(noneCount, AddResult, &callbacks);
+  printf("callbacks so far: %s\n", atomic_load(&callbacks) >= 1 ? "ok" : "missing");
+
+  Future* printed = print_async(none, RowPrinter);
+  printf("printed: %ld\n", future_wait(printed));
+  printf("none: %ld\n", future_wait(noneCount));
+  printf("joined: %ld\n", future_wait(joinedCount));
+  printf("rows: %ld\n", future_wait(rowsCount));
+  printf("total: %d, callbacks: %d\n", atomic_load(&total), atomic_load(&callbacks));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
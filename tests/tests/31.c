@@ -0,0 +1,71 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 1000
+
+// Every file has a row of its own key, plus one "asdf" and one "qwer"
+// row: 1002 distinct keys over 3000 rows.
+atomic_int hashed = 0;
+
+unsigned long CountedKeyHash(void* arg, void* ctx) {
+  atomic_fetch_add(&hashed, 1);
+  return SumJoinKeyHash(arg, ctx);
+}
+
+// a partial result of a count: the key and 1
+void* CountOne(void* arg) {
+  struct row* row = malloc(sizeof(struct row));
+  memcpy(row, arg, sizeof(struct row));
+  strcpy(row->cols[1], "1");
+  return row;
+}
+
+int IsRepeated(void* arg, void* ctx) {
+  (void)ctx;
+  struct row* row = (struct row*)arg;
+  return strcmp(row->cols[0], "asdf") == 0 || strcmp(row->cols[0], "qwer") == 0;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* rows = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols);
+  RDD* sums = reduceByKey(rows, SumByKey, SumJoinKeyHash, 4, &sctx);
+  printf("keys: %ld\n", count(sums));
+  print(filter(sums, IsRepeated, NULL), RowPrinter);
+
+  // Two partitions holding every key once: each partial result crosses
+  // the shuffle once, so every row is hashed once on the map side and
+  // each of the 1002 partial results once on the reduce side.
+  RDD* grouped = partitionBy(rows, ColumnHashPartitioner, 2, &pctx);
+  count(grouped);
+  RDD* counts = aggregateByKey(grouped, CountOne, SumByKey, CountedKeyHash, 3, &sctx);
+  printf("keys: %ld\n", count(counts));
+  printf("shuffled: %d\n", atomic_load(&hashed) - 3 * NUMFILES);
+  print(filter(counts, IsRepeated, NULL), RowPrinter);
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
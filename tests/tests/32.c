@@ -0,0 +1,66 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 1000
+
+// Each file holds three rows, the first of them keyed by the file number.
+atomic_int rowsRead = 0;
+
+void* CountRow(void* arg) {
+  atomic_fetch_add(&rowsRead, 1);
+  return arg;
+}
+
+int KeyIs(void* arg, void* key) {
+  return strcmp(((struct row*)arg)->cols[0], (char*)key) == 0;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  void* rows[8];
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* files = RDDFromFiles(filenames, NUMFILES);
+  RDD* lines = map(map(map(files, GetLines), SplitCols), CountRow);
+  int n = take(lines, 5, rows);
+  printf("took %d:\n", n);
+  for (int i = 0; i < n; i++)
+    RowPrinter(rows[i]);
+  printf("few rows read: %s\n", atomic_load(&rowsRead) < 100 ? "yes" : "no");
+
+  // the only match is in the last file
+  RowPrinter(first(filter(lines, KeyIs, "999")));
+  printf("empty: %s\n", first(filter(lines, KeyIs, "nope")) ? "no" : "yes");
+
+  // wide RDDs are computed whole, stored ones are read
+  RDD* parts = partitionBy(lines, ColumnHashPartitioner, 4, &pctx);
+  printf("took %ld of a partitionBy\n", take(parts, 8, rows));
+  printf("count: %ld\n", count(lines));
+  n = take(lines, 2, rows);
+  printf("took %d stored:\n", n);
+  for (int i = 0; i < n; i++)
+    RowPrinter(rows[i]);
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 1000
+
+// Rows "i 2i", "asdf 1" and "qwer i" of every file i, ordered by value
+// and then by key.
+int ByValue(void* arg1, void* arg2, void* ctx) {
+  (void)ctx;
+  struct row* a = (struct row*)arg1;
+  struct row* b = (struct row*)arg2;
+  int va = atoi(a->cols[1]);
+  int vb = atoi(b->cols[1]);
+  if (va != vb)
+    return va < vb ? -1 : 1;
+  return strcmp(a->cols[0], b->cols[0]);
+}
+
+int ByValueDesc(void* arg1, void* arg2, void* ctx) {
+  return ByValue(arg2, arg1, ctx);
+}
+
+int IsNothing(void* arg, void* ctx) {
+  (void)arg;
+  (void)ctx;
+  return 0;
+}
+
+struct row* prev = NULL;
+int misordered = 0;
+
+void CheckOrder(void* arg) {
+  if (prev && ByValue(prev, arg, NULL) > 0)
+    misordered++;
+  prev = (struct row*)arg;
+}
+
+void checkSorted(RDD* rdd) {
+  prev = NULL;
+  misordered = 0;
+  print(rdd, CheckOrder);
+  printf("count: %ld, misordered: %d\n", count(rdd), misordered);
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  void* out[8];
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* rows = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols);
+
+  // takeOrdered() of a narrow chain, before anything is stored
+  int n = takeOrdered(rows, 5, ByValueDesc, NULL, out);
+  printf("top %d:\n", n);
+  for (int i = 0; i < n; i++)
+    RowPrinter(out[i]);
+  // every task holds more rows than that, and cuts them down as it goes
+  n = takeOrdered(rows, 1, ByValueDesc, NULL, out);
+  printf("top %d:\n", n);
+  RowPrinter(out[0]);
+
+  RDD* sorted = sortBy(rows, ByValue, 8, NULL);
+  checkSorted(sorted);
+  // the 1000 "asdf 1" rows all land in one partition
+  int nonempty = 0;
+  for (int i = 0; i < sorted->numpartitions; i++)
+    nonempty += get_size(get_nth_elem(sorted->partitions, i)) > 0;
+  printf("partitions: %d, nonempty: %s\n", sorted->numpartitions,
+         nonempty > 4 ? "most" : "few");
+  checkSorted(sortBy(sorted, ByValue, 1, NULL));
+  checkSorted(sortBy(filter(rows, IsNothing, NULL), ByValue, 4, NULL));
+
+  // and of a stored, wide RDD
+  n = takeOrdered(sorted, 3, ByValue, NULL, out);
+  printf("bottom %d:\n", n);
+  for (int i = 0; i < n; i++)
+    RowPrinter(out[i]);
+  printf("of nothing: %ld\n",
+         takeOrdered(filter(rows, IsNothing, NULL), 3, ByValue, NULL, out));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
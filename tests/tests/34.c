@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 1000
+#define NUMDIM 3
+
+// Every file i has rows "i 2i", "asdf 1" and "qwer i". Joined with the
+// rows of the first NUMDIM files, keys 0 to NUMDIM - 1 match once and
+// asdf and qwer NUMDIM times per row.
+int IsNumbered(void* arg, void* ctx) {
+  (void)ctx;
+  struct row* row = (struct row*)arg;
+  return strcmp(row->cols[0], "asdf") != 0 && strcmp(row->cols[0], "qwer") != 0;
+}
+
+int IsNothing(void* arg, void* ctx) {
+  (void)arg;
+  (void)ctx;
+  return 0;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* facts = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols);
+  RDD* dim = map(map(RDDFromFiles(filenames, NUMDIM), GetLines), SplitCols);
+
+  // neither side is computed yet, and the facts are never shuffled
+  RDD* joined = broadcastJoin(facts, dim, SumJoin, SumJoinKeyHash, &sctx);
+  printf("joined: %ld in %d partitions\n", count(joined), joined->numpartitions);
+  print(filter(joined, IsNumbered, NULL), RowPrinter);
+
+  // the same join, co-partitioning both sides first
+  RDD* shuffled = hashJoin(partitionBy(facts, ColumnHashPartitioner, 8, &pctx),
+                           partitionBy(dim, ColumnHashPartitioner, 8, &pctx),
+                           SumJoin, SumJoinKeyHash, &sctx);
+  printf("hash joined: %ld\n", count(shuffled));
+
+  // an input both broadcast and probed, and one that is empty
+  RDD* again = map(map(RDDFromFiles(filenames, NUMDIM), GetLines), SplitCols);
+  printf("self: %ld\n", count(broadcastJoin(again, again, SumJoin, SumJoinKeyHash, &sctx)));
+  printf("empty: %ld\n",
+         count(broadcastJoin(facts, filter(dim, IsNothing, NULL), SumJoin,
+                             SumJoinKeyHash, &sctx)));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 1000
+
+// Reading every file twice gives 2000 rows each of the keys asdf and
+// qwer, whose 4M pairs all land in one partition: hot keys, which are
+// split over several morsels. Keys 0 to 999 have 4 pairs each.
+atomic_long numpairs = 0;
+atomic_long hotpairs = 0;
+
+void* CountPair(void* arg1, void* arg2, void* ctx) {
+  (void)ctx;
+  struct row* a = (struct row*)arg1;
+  struct row* b = (struct row*)arg2;
+  if (strcmp(a->cols[0], b->cols[0]) == 0) {
+    atomic_fetch_add(&numpairs, 1);
+    if (strcmp(a->cols[0], "asdf") == 0 || strcmp(a->cols[0], "qwer") == 0)
+      atomic_fetch_add(&hotpairs, 1);
+  }
+  // only "1 2" with itself is kept
+  return strcmp(a->cols[0], "1") == 0 && strcmp(b->cols[0], "1") == 0 ? a : NULL;
+}
+
+int main() {
+  char *filenames[2 * NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < 2 * NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i % NUMFILES);
+  }
+
+  MS_Run();
+
+  RDD* rows = map(map(RDDFromFiles(filenames, 2 * NUMFILES), GetLines), SplitCols);
+  RDD* parts = partitionBy(rows, ColumnHashPartitioner, 4, &pctx);
+  RDD* joined = hashJoin(parts, parts, CountPair, SumJoinKeyHash, &sctx);
+  printf("kept: %ld\n", count(joined));
+  print(joined, RowPrinter);
+  printf("pairs: %ld, of hot keys: %ld\n", atomic_load(&numpairs),
+         atomic_load(&hotpairs));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < 2 * NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 1000
+#define NUMDIM 3
+
+// Joined with the rows of the first NUMDIM files, the rows "i 2i" of
+// the other files never match, while every "asdf" and "qwer" row does.
+atomic_int partitioned = 0;
+
+unsigned long CountedPartitioner(void* arg, int numpartitions, void* ctx) {
+  atomic_fetch_add(&partitioned, 1);
+  return ColumnHashPartitioner(arg, numpartitions, ctx);
+}
+
+int IsNothing(void* arg, void* ctx) {
+  (void)arg;
+  (void)ctx;
+  return 0;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* facts = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols);
+  RDD* dim = map(map(RDDFromFiles(filenames, NUMDIM), GetLines), SplitCols);
+  RDD* dimparts = partitionBy(dim, ColumnHashPartitioner, 8, &pctx);
+
+  RDD* matching = semiJoinFilter(facts, dim, SumJoinKeyHash, &sctx);
+  RDD* joined = hashJoin(partitionBy(matching, CountedPartitioner, 8, &pctx),
+                         dimparts, SumJoin, SumJoinKeyHash, &sctx);
+  printf("joined: %ld\n", count(joined));
+  int kept = count(matching);
+  printf("kept all %d matching rows: %s\n", 2 * NUMFILES + NUMDIM,
+         kept >= 2 * NUMFILES + NUMDIM ? "yes" : "no");
+  printf("few others: %s\n", kept < 2 * NUMFILES + NUMDIM + 50 ? "yes" : "no");
+  printf("only those shuffled: %s\n", atomic_load(&partitioned) == kept ? "yes" : "no");
+
+  // the same join without the filter
+  RDD* all = hashJoin(partitionBy(facts, ColumnHashPartitioner, 8, &pctx),
+                      dimparts, SumJoin, SumJoinKeyHash, &sctx);
+  printf("joined unfiltered: %ld\n", count(all));
+
+  printf("against nothing: %ld\n",
+         count(semiJoinFilter(facts, filter(dim, IsNothing, NULL),
+                              SumJoinKeyHash, &sctx)));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
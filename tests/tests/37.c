@@ -0,0 +1,93 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 1000
+
+#define WIDE (20 << 10)
+
+// File i has the rows "i 2i", "asdf 1" and "qwer i". Every row is copied
+// into odd-sized MS_Alloc() buffers, which must stay valid downstream.
+atomic_int misaligned = 0;
+
+void* OddCopy(void* arg) {
+  char* pad = MS_Alloc(1 + strlen(((struct row*)arg)->cols[0]));
+  strcpy(pad, ((struct row*)arg)->cols[0]);
+  struct row* row = MS_Alloc(sizeof(struct row));
+  if ((uintptr_t)row % _Alignof(max_align_t) != 0) {
+    atomic_fetch_add(&misaligned, 1);
+  }
+  memcpy(row, arg, sizeof(struct row));
+  strcpy(row->cols[0], pad);
+  return row;
+}
+
+void* Wide(void* arg) {
+  // bigger than a quarter of an arena chunk, so it gets one of its own
+  char* big = MS_Alloc(WIDE);
+  memset(big, 'x', WIDE);
+  return arg;
+}
+
+int IsAsdf(void* arg, void* ctx) {
+  (void)ctx;
+  return !strcmp(((struct row*)arg)->cols[0], "asdf");
+}
+
+long Sum(RDD* rdd) {
+  void* rows[8];
+  int n = take(rdd, 8, rows);
+  long sum = 0;
+  for (int i = 0; i < n; i++) {
+    sum += atoi(((struct row*)rows[i])->cols[1]);
+  }
+  return sum;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* rows = map(map(map(RDDFromFiles(filenames, NUMFILES), GetLines),
+                      SplitCols), OddCopy);
+  printf("rows: %ld\n", count(map(rows, Wide)));
+
+  RDD* sums = reduceByKey(partitionBy(map(rows, OddCopy),
+                                      ColumnHashPartitioner, 8, &pctx),
+                          SumByKey, SumJoinKeyHash, 8, &sctx);
+  printf("keys: %ld\n", count(sums));
+  RDD* asdf = filter(sums, IsAsdf, NULL);
+  printf("asdf: %ld\n", Sum(asdf));
+
+  RDD* joined = hashJoin(rows, map(rows, OddCopy), SumJoin, SumJoinKeyHash,
+                         &sctx);
+  printf("joined: %ld\n", count(joined));
+
+  struct row* outside = MS_Alloc(sizeof(struct row));
+  printf("aligned: %s\n", atomic_load(&misaligned) == 0 &&
+         (uintptr_t)outside % _Alignof(max_align_t) == 0 ? "yes" : "no");
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 100
+
+// File i has the rows "i 2i", "asdf 1" and "qwer i".
+atomic_int destroyed = 0;
+
+void Destroy(void* arg) {
+  (void)arg;
+  atomic_fetch_add(&destroyed, 1);
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  struct colpart_ctx pctx = {0};
+  struct sumjoin_ctx sctx = {0, 1};
+
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* rows = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SplitCols);
+  RDD* parts = ownElements(partitionBy(rows, ColumnHashPartitioner, 8, &pctx),
+                           Destroy);
+  RDD* joined = hashJoin(parts, parts, SumJoin, SumJoinKeyHash, &sctx);
+
+  printf("joined: %ld\n", count(joined));
+  printf("released after the join: %d\n", atomic_load(&destroyed));
+
+  // computed again, and kept this time
+  printf("parts: %ld\n", count(parts));
+  printf("joined again: %ld\n", count(joined));
+  printf("rejoined: %ld\n",
+         count(hashJoin(parts, parts, SumJoin, SumJoinKeyHash, &sctx)));
+  printf("released after the rest: %d\n", atomic_load(&destroyed));
+
+  MS_TearDown();
+  printf("released by teardown: %d\n", atomic_load(&destroyed));
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
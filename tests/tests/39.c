@@ -0,0 +1,70 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 4
+
+// File i has the rows "i 2i", "asdf 1" and "qwer i". Every mapper
+// counts the rows it saw on the driver thread and on the workers.
+pthread_t driver;
+atomic_int onDriver = 0;
+atomic_int onWorkers = 0;
+
+void* Where(void* arg) {
+  if (pthread_equal(pthread_self(), driver)) {
+    atomic_fetch_add(&onDriver, 1);
+  } else {
+    atomic_fetch_add(&onWorkers, 1);
+  }
+  return arg;
+}
+
+void* SlowWhere(void* arg) {
+  struct timespec req = {.tv_sec = 0, .tv_nsec = 5 * 1000 * 1000};
+  nanosleep(&req, NULL);
+  return Where(arg);
+}
+
+void Report(const char* what, long n) {
+  printf("%s: %ld, on the driver: %d, on the workers: %s\n", what, n,
+         atomic_load(&onDriver), atomic_load(&onWorkers) > 0 ? "yes" : "no");
+  atomic_store(&onDriver, 0);
+  atomic_store(&onWorkers, 0);
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+  driver = pthread_self();
+
+  MS_Run();
+
+  // never ran before, so its cost is unknown: the workers compute it
+  RDD* first = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), Where);
+  Report("unknown cost", count(first));
+
+  // a new DAG of the same shape is known to be cheap and tiny, and
+  // computed inline
+  RDD* again = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), Where);
+  Report("known cheap", count(again));
+
+  // just as tiny, but unknown and then known to be slow: the workers
+  RDD* slow =
+      map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SlowWhere);
+  Report("unknown slow", count(slow));
+  slow = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), SlowWhere);
+  Report("known slow", count(slow));
+
+  MS_TearDown();
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 100
+#define NUMPARTITIONS 8
+
+// File i has the rows "i 2i", "asdf 1" and "qwer i". The partitioner
+// counts its calls, which must be one per row whatever the number of
+// output partitions.
+atomic_long calls = 0;
+
+unsigned long CountingPartitioner(void* arg, int numpartitions, void* ctx) {
+  (void)ctx;
+  atomic_fetch_add(&calls, 1);
+  unsigned long hash = 5381;
+  for (char* c = (char*)arg; *c; c++) {
+    hash = hash * 33 + (unsigned char)*c;
+  }
+  return hash % numpartitions;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* lines = map(RDDFromFiles(filenames, NUMFILES), GetLines);
+  RDD* shuffled =
+      partitionBy(lines, CountingPartitioner, NUMPARTITIONS, NULL);
+  long rows = count(shuffled);
+  printf("rows: %ld, partitioner calls: %ld\n", rows, atomic_load(&calls));
+
+  MS_TearDown();
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+  return 0;
+}
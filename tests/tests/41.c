@@ -0,0 +1,61 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 4
+
+// File i has the rows "i 2i", "asdf 1" and "qwer i". The first row
+// holds the first job back until the next DAG over its RDD has been
+// launched, or for ten seconds: a launch that waited for the job would
+// find it done.
+atomic_int launched = 0;
+atomic_int rowsSeen = 0;
+
+void* WaitForLaunch(void* arg) {
+  if (atomic_fetch_add(&rowsSeen, 1) == 0) {
+    struct timespec req = {.tv_sec = 0, .tv_nsec = 10 * 1000 * 1000};
+    for (int i = 0; i < 1000 && !atomic_load(&launched); i++)
+      nanosleep(&req, NULL);
+  }
+  return arg;
+}
+
+void* Id(void* arg) {
+  return arg;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  MS_Run();
+
+  RDD* rows = map(map(RDDFromFiles(filenames, NUMFILES), GetLines), WaitForLaunch);
+  Future* rowsCount = count_async(rows);
+  Future* mappedCount = count_async(map(rows, Id));
+  int running = !future_poll(rowsCount);
+  atomic_store(&launched, 1);
+  printf("launched while the first job ran: %s\n", running ? "yes" : "no");
+
+  // a blocking action over it is deferred the same way
+  printf("counted: %ld\n", count(map(rows, Id)));
+  printf("mapped: %ld\n", future_wait(mappedCount));
+  printf("rows: %ld\n", future_wait(rowsCount));
+
+  MS_TearDown();
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+  return 0;
+}
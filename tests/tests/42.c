@@ -0,0 +1,120 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define NUMFILES 4
+#define NUMROWS (3 * NUMFILES)
+
+// File i has the rows "i 2i", "asdf 1" and "qwer i". With one worker,
+// the first row of the gate job holds it back until the next job is
+// planned, so all the tasks that job can start with are queued at once.
+atomic_int released = 0;
+atomic_int rowsSeen = 0;
+
+// Rows seen by the costly branch of that job and by the cheap ones, and
+// whether the costly branch had seen all of its rows when the first
+// cheap one ran.
+atomic_int costlySeen = 0;
+atomic_int cheapSeen = 0;
+atomic_int costlyFirst = 0;
+
+int Slow(void* arg, void* ctx) {
+  (void)arg;
+  (void)ctx;
+  struct timespec req = {.tv_sec = 0, .tv_nsec = 2 * 1000 * 1000};
+  nanosleep(&req, NULL);
+  return 1;
+}
+
+int WaitForRelease(void* arg, void* ctx) {
+  (void)arg;
+  (void)ctx;
+  if (atomic_fetch_add(&rowsSeen, 1) == 0) {
+    struct timespec req = {.tv_sec = 0, .tv_nsec = 10 * 1000 * 1000};
+    for (int i = 0; i < 1000 && !atomic_load(&released); i++)
+      nanosleep(&req, NULL);
+  }
+  return 1;
+}
+
+int MarkCostly(void* arg, void* ctx) {
+  (void)arg;
+  (void)ctx;
+  atomic_fetch_add(&costlySeen, 1);
+  return 1;
+}
+
+void* MarkCheap(void* arg) {
+  if (atomic_fetch_add(&cheapSeen, 1) == 0)
+    atomic_store(&costlyFirst, atomic_load(&costlySeen) == NUMROWS);
+  return arg;
+}
+
+void* NoMatch(void* row1, void* row2, void* ctx) {
+  (void)row1;
+  (void)row2;
+  (void)ctx;
+  return NULL;
+}
+
+int main() {
+  char *filenames[NUMFILES];
+  for (int i = 0; i < NUMFILES; i++) {
+    filenames[i] = calloc(30, 1);
+    sprintf(filenames[i], "./test_files/%d", i);
+  }
+
+  // one worker, so the queued tasks run one at a time
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(sched_getcpu(), &set);
+  if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+    perror("sched_setaffinity");
+    exit(EXIT_FAILURE);
+  }
+
+  MS_Run();
+
+  // tasks of a FILTER are known to be slow from now on
+  RDD* slow = filter(map(RDDFromFiles(filenames, NUMFILES), GetLines), Slow,
+                     NULL);
+  printf("slow: %ld\n", count(slow));
+
+  RDD* gate = filter(map(RDDFromFiles(filenames, NUMFILES), GetLines),
+                     WaitForRelease, NULL);
+  Future* gateCount = count_async(gate);
+
+  // The costly branch is on the longest critical path, so its tasks go
+  // first, although they are queued between those of the cheap ones.
+  RDD* cheap1 =
+      map(map(RDDFromFiles(filenames, NUMFILES), GetLines), MarkCheap);
+  RDD* costly = filter(map(RDDFromFiles(filenames, NUMFILES), GetLines),
+                       MarkCostly, NULL);
+  RDD* cheap2 =
+      map(map(RDDFromFiles(filenames, NUMFILES), GetLines), MarkCheap);
+  RDD* joined =
+      join(join(costly, cheap2, NoMatch, NULL), cheap1, NoMatch, NULL);
+  Future* joinedCount = count_async(joined);
+  atomic_store(&released, 1);
+
+  printf("gate: %ld\n", future_wait(gateCount));
+  printf("joined: %ld\n", future_wait(joinedCount));
+  printf("costly branch first: %s\n",
+         atomic_load(&costlyFirst) ? "yes" : "no");
+
+  MS_TearDown();
+  for (int i = 0; i < NUMFILES; i++) {
+    free(filenames[i]);
+  }
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+  }
+  return 0;
+}